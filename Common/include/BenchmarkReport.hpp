@@ -0,0 +1,51 @@
+#ifndef BENCHMARK_REPORT_HPP
+#define BENCHMARK_REPORT_HPP
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+//Machine-readable side channel for bench/runbench.py. When the BENCHMARK_REPORT environment variable
+//names a file, every record() appends one JSON line with the metric to it, otherwise it does nothing
+//and benchmarks only print their usual tables. Names are '/'-separated paths such as
+//"stripedhashmap/striped/reads=90/threads=4". A name recorded several times counts as several samples.
+class BenchmarkReport
+{
+    public:
+        enum Better
+        {
+            HIGHER, LOWER
+        };
+
+        static void record(const std::string& name, double value, const std::string& unit, Better better = HIGHER);
+
+    private:
+        static std::string quote(const std::string& text);
+};
+
+
+
+inline void BenchmarkReport::record(const std::string& name, double value, const std::string& unit, Better better)
+{
+    const char* path = std::getenv("BENCHMARK_REPORT");
+    if(path == nullptr || *path == '\0')
+        return;
+    std::ofstream report(path, std::ios::app);
+    report.precision(17);
+    report << "{\"name\": " << quote(name) << ", \"value\": " << value << ", \"unit\": " << quote(unit)
+           << ", \"better\": \"" << (better == HIGHER ? "higher" : "lower") << "\"}" << std::endl;
+}
+
+inline std::string BenchmarkReport::quote(const std::string& text)
+{
+    std::string quoted = "\"";
+    for(char c: text)
+    {
+        if(c == '"' || c == '\\')
+            quoted += '\\';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef CACHE_PADDED_HPP
+#define CACHE_PADDED_HPP
+
+#include <cstddef>
+#include <new>
+#include <utility>
+
+//Smallest distance that keeps two objects written by different threads off the same cache line.
+//Comes from the standard library when it provides it, 64 (x86, most ARM cores) otherwise.
+//Shared-memory layouts that must agree between differently built processes should use a literal instead.
+#if defined(__cpp_lib_hardware_interference_size)
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winterference-size"
+#endif
+const size_t CACHE_LINE_SIZE = std::hardware_destructive_interference_size;
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic pop
+#endif
+#else
+const size_t CACHE_LINE_SIZE = 64;
+#endif
+
+//CACHE_ALIGNED starts a member on its own cache line, CachePadded<T> also pads the object to a
+//whole line, for elements of arrays and vectors of per-thread data. Defining CACHE_PADDING_DISABLED
+//turns both off, so benchmarks can be built with the old layout for before/after comparisons.
+//Over-aligned objects on the heap need C++17 aligned new.
+#ifndef CACHE_PADDING_DISABLED
+#define CACHE_ALIGNED alignas(CACHE_LINE_SIZE)
+#else
+#define CACHE_ALIGNED
+#endif
+
+template <class T>
+struct CACHE_ALIGNED CachePadded
+{
+    CachePadded():value() {}
+    explicit CachePadded(const T& item):value(item) {}
+    explicit CachePadded(T&& item):value(std::move(item)) {}
+
+    T& operator*() { return value; }
+    const T& operator*() const { return value; }
+    T* operator->() { return &value; }
+    const T* operator->() const { return &value; }
+
+    T value;
+};
+
+#endif
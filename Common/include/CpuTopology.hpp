@@ -0,0 +1,375 @@
+#ifndef CPU_TOPOLOGY_HPP
+#define CPU_TOPOLOGY_HPP
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+//Logical CPU as seen by Linux: which physical core, package and NUMA node it belongs to and which
+//L2/L3 instance it shares (identified by the lowest CPU sharing it, -1 when unknown).
+struct CpuInfo
+{
+    int id;
+    int core;
+    int package;
+    int node;
+    int l2;
+    int l3;
+};
+
+//Machine layout read from sysfs (/sys/devices/system/cpu and /sys/devices/system/node), plus
+//thread placement. Without sysfs every CPU from hardware_concurrency() is its own core.
+//COMPACT fills SMT siblings and then the cores of one package before moving on,
+//SCATTER spreads threads over packages first, then cores, and uses SMT siblings last,
+//ONE_PER_CORE takes the first allowed logical CPU of every core in compact order.
+//Placements only use allowed CPUs, instance() allows the process affinity mask (cpuset,
+//taskset), and wrap around when there are more threads than CPUs.
+class CpuTopology
+{
+    public:
+        enum Policy
+        {
+            COMPACT, SCATTER, ONE_PER_CORE
+        };
+
+        explicit CpuTopology(const std::string& cpuRoot = "/sys/devices/system/cpu",
+                             const std::string& nodeRoot = "/sys/devices/system/node");
+        //The running machine restricted to the process affinity, read once
+        static const CpuTopology& instance();
+
+        const std::vector<CpuInfo>& cpus() const;
+        const CpuInfo* cpu(int id) const;
+        size_t cores() const;
+        size_t packages() const;
+        size_t nodes() const;
+        //CPUs on the same core as cpu, cpu included
+        std::vector<int> smtSiblings(int cpu) const;
+        //CPUs sharing the level 2 or 3 cache with cpu, cpu included
+        std::vector<int> sharingCache(int cpu, int level) const;
+        //Restricts placement to cpus, an empty list allows every CPU
+        void allow(const std::vector<int>& cpus);
+        bool allowed(int cpu) const;
+        //Logical CPU for each of threads threads, every CPU when none of them is allowed
+        std::vector<int> placement(Policy policy, size_t threads) const;
+        //One line summary for benchmark headers
+        std::string describe() const;
+
+        //Both return false when the CPU cannot be used, the thread then stays unpinned
+        static bool pinCurrentThread(int cpu);
+        static bool pin(std::thread& thread, int cpu);
+        //CPUs the process may run on (affinity of its main thread, which pinning leaves alone),
+        //empty when sched_getaffinity fails
+        static std::vector<int> affinity();
+        //"0-3,8,10-11" as used by sysfs
+        static std::vector<int> parseCpuList(const std::string& list);
+
+    private:
+        std::vector<CpuInfo> cpus_;
+        //Sorted, empty when everything is allowed
+        std::vector<int> allowed_;
+
+        static std::string readLine(const std::string& path);
+        static int readInt(const std::string& path, int fallback);
+        void readCaches(const std::string& cpuRoot, CpuInfo& info) const;
+        std::vector<int> compactOrder() const;
+        std::vector<int> scatterOrder() const;
+        template <class KEY>
+        size_t countDistinct(KEY key) const;
+};
+
+
+
+inline CpuTopology::CpuTopology(const std::string& cpuRoot, const std::string& nodeRoot)
+{
+    std::vector<int> online = parseCpuList(readLine(cpuRoot + "/online"));
+    std::map<int, int> nodeOf;
+    for(int node: parseCpuList(readLine(nodeRoot + "/online")))
+        for(int id: parseCpuList(readLine(nodeRoot + "/node" + std::to_string(node) + "/cpulist")))
+            nodeOf[id] = node;
+    for(int id: online)
+    {
+        std::string topology = cpuRoot + "/cpu" + std::to_string(id) + "/topology/";
+        CpuInfo info = {id, readInt(topology + "core_id", id), readInt(topology + "physical_package_id", 0),
+                        nodeOf.count(id) ? nodeOf[id] : 0, -1, -1};
+        readCaches(cpuRoot, info);
+        cpus_.push_back(info);
+    }
+    if(cpus_.empty())
+    {
+        unsigned int count = std::max(1u, std::thread::hardware_concurrency());
+        for(unsigned int id = 0; id < count; ++id)
+            cpus_.push_back({int(id), int(id), 0, 0, -1, -1});
+    }
+}
+
+inline const CpuTopology& CpuTopology::instance()
+{
+    static const CpuTopology topology = [](){
+        CpuTopology machine;
+        machine.allow(affinity());
+        return machine;
+    }();
+    return topology;
+}
+
+inline const std::vector<CpuInfo>& CpuTopology::cpus() const
+{
+    return cpus_;
+}
+
+inline const CpuInfo* CpuTopology::cpu(int id) const
+{
+    for(auto& info: cpus_)
+        if(info.id == id)
+            return &info;
+    return nullptr;
+}
+
+inline size_t CpuTopology::cores() const
+{
+    return countDistinct([](const CpuInfo& info){ return std::make_pair(info.package, info.core); });
+}
+
+inline size_t CpuTopology::packages() const
+{
+    return countDistinct([](const CpuInfo& info){ return info.package; });
+}
+
+inline size_t CpuTopology::nodes() const
+{
+    return countDistinct([](const CpuInfo& info){ return info.node; });
+}
+
+inline std::vector<int> CpuTopology::smtSiblings(int id) const
+{
+    std::vector<int> siblings;
+    const CpuInfo* self = cpu(id);
+    if(self == nullptr)
+        return siblings;
+    for(auto& info: cpus_)
+        if(info.package == self->package && info.core == self->core)
+            siblings.push_back(info.id);
+    return siblings;
+}
+
+inline std::vector<int> CpuTopology::sharingCache(int id, int level) const
+{
+    std::vector<int> sharing;
+    const CpuInfo* self = cpu(id);
+    if(self == nullptr)
+        return sharing;
+    int cache = level == 2 ? self->l2 : self->l3;
+    if(cache < 0)
+        return std::vector<int>(1, id);
+    for(auto& info: cpus_)
+        if((level == 2 ? info.l2 : info.l3) == cache)
+            sharing.push_back(info.id);
+    return sharing;
+}
+
+inline void CpuTopology::allow(const std::vector<int>& cpus)
+{
+    allowed_ = cpus;
+    std::sort(allowed_.begin(), allowed_.end());
+}
+
+inline bool CpuTopology::allowed(int cpu) const
+{
+    return allowed_.empty() || std::binary_search(allowed_.begin(), allowed_.end(), cpu);
+}
+
+inline std::vector<int> CpuTopology::placement(Policy policy, size_t threads) const
+{
+    std::vector<int> order = policy == SCATTER ? scatterOrder() : compactOrder();
+    std::vector<int> usable;
+    for(int id: order)
+        if(allowed(id))
+            usable.push_back(id);
+    if(!usable.empty())
+        order = usable;
+    if(policy == ONE_PER_CORE)
+    {
+        std::vector<int> primaries;
+        std::vector<std::pair<int, int>> seen;
+        for(int id: order)
+        {
+            auto core = std::make_pair(cpu(id)->package, cpu(id)->core);
+            if(std::find(seen.begin(), seen.end(), core) != seen.end())
+                continue;
+            seen.push_back(core);
+            primaries.push_back(id);
+        }
+        order = primaries;
+    }
+    std::vector<int> placement;
+    for(size_t i = 0; i < threads; ++i)
+        placement.push_back(order[i % order.size()]);
+    return placement;
+}
+
+inline std::string CpuTopology::describe() const
+{
+    std::stringstream stream;
+    stream << cpus_.size() << " CPUs, " << cores() << " cores, " << packages() << " packages, "
+           << nodes() << " NUMA nodes";
+    return stream.str();
+}
+
+inline bool CpuTopology::pinCurrentThread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+inline bool CpuTopology::pin(std::thread& thread, int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+}
+
+inline std::vector<int> CpuTopology::affinity()
+{
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(getpid(), sizeof(set), &set) != 0)
+        return cpus;
+    for(int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        if(CPU_ISSET(cpu, &set))
+            cpus.push_back(cpu);
+    return cpus;
+}
+
+inline std::vector<int> CpuTopology::parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while(std::getline(stream, range, ','))
+    {
+        if(range.empty() || range[0] < '0' || range[0] > '9')
+            continue;
+        size_t dash = range.find('-');
+        int first = std::atoi(range.c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+        for(int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+inline std::string CpuTopology::readLine(const std::string& path)
+{
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+inline int CpuTopology::readInt(const std::string& path, int fallback)
+{
+    std::ifstream file(path);
+    int value;
+    if(!(file >> value))
+        return fallback;
+    return value;
+}
+
+inline void CpuTopology::readCaches(const std::string& cpuRoot, CpuInfo& info) const
+{
+    std::string cache = cpuRoot + "/cpu" + std::to_string(info.id) + "/cache/index";
+    for(int index = 0; ; ++index)
+    {
+        std::string path = cache + std::to_string(index) + "/";
+        int level = readInt(path + "level", -1);
+        if(level < 0)
+            break;
+        if(readLine(path + "type") == "Instruction")
+            continue;
+        std::vector<int> shared = parseCpuList(readLine(path + "shared_cpu_list"));
+        int id = shared.empty() ? info.id : *std::min_element(shared.begin(), shared.end());
+        if(level == 2)
+            info.l2 = id;
+        else if(level == 3)
+            info.l3 = id;
+    }
+}
+
+inline std::vector<int> CpuTopology::compactOrder() const
+{
+    std::vector<CpuInfo> sorted = cpus_;
+    std::sort(sorted.begin(), sorted.end(), [](const CpuInfo& first, const CpuInfo& second){
+        return std::make_tuple(first.node, first.package, first.l3, first.core, first.id) <
+               std::make_tuple(second.node, second.package, second.l3, second.core, second.id);
+    });
+    std::vector<int> order;
+    for(auto& info: sorted)
+        order.push_back(info.id);
+    return order;
+}
+
+inline std::vector<int> CpuTopology::scatterOrder() const
+{
+    //packages[p][c] lists the SMT siblings of the c-th core of the p-th package
+    std::vector<std::vector<std::vector<int>>> packages;
+    std::map<int, size_t> packageIndex;
+    std::map<std::pair<int, int>, size_t> coreIndex;
+    for(int id: compactOrder())
+    {
+        const CpuInfo& info = *cpu(id);
+        if(!packageIndex.count(info.package))
+        {
+            packageIndex[info.package] = packages.size();
+            packages.emplace_back();
+        }
+        auto& cores = packages[packageIndex[info.package]];
+        auto key = std::make_pair(info.package, info.core);
+        if(!coreIndex.count(key))
+        {
+            coreIndex[key] = cores.size();
+            cores.emplace_back();
+        }
+        cores[coreIndex[key]].push_back(id);
+    }
+    std::vector<int> order;
+    for(size_t smt = 0; order.size() < cpus_.size(); ++smt)
+        for(size_t core = 0; ; ++core)
+        {
+            bool any = false;
+            for(auto& cores: packages)
+                if(core < cores.size())
+                {
+                    any = true;
+                    if(smt < cores[core].size())
+                        order.push_back(cores[core][smt]);
+                }
+            if(!any)
+                break;
+        }
+    return order;
+}
+
+template <class KEY>
+size_t CpuTopology::countDistinct(KEY key) const
+{
+    std::vector<decltype(key(cpus_[0]))> keys;
+    for(auto& info: cpus_)
+        keys.push_back(key(info));
+    std::sort(keys.begin(), keys.end());
+    return std::unique(keys.begin(), keys.end()) - keys.begin();
+}
+
+#endif
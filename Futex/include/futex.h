@@ -1,4 +1,4 @@
-#ifndef FUTEXT_H
+#ifndef FUTEX_H
 #define FUTEX_H
 
 #include <thread>
@@ -11,8 +11,10 @@ class Futex{
         bool unlock(int hash);
         std::hash<std::thread::id> Hasher;
     private:
-        std::atomic<uint8_t> ownerId_;
-        int hash0_;
+        //FREE when unlocked, otherwise the owner's hash (never FREE itself, see owner())
+        std::atomic<int> ownerId_;
+        static const int FREE = 0;
+        static int owner(int hash);
         Futex(const Futex& futex) = delete;
 };
 
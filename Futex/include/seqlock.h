@@ -0,0 +1,127 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <futex.h>
+#include <CachePadded.hpp>
+
+//Read-mostly snapshot of a trivially copyable T. Readers never write shared memory: they read the
+//sequence, copy the value word by word with relaxed atomic loads and retry if the sequence was odd
+//(write in progress) or changed meanwhile. Writers take a Futex, so they serialize among themselves
+//but never block readers, who only spin while a store is actually copying.
+template <class T>
+class SeqLock{
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock copies T as raw words");
+    public:
+        SeqLock();
+        explicit SeqLock(const T& value);
+        T load() const;
+        void store(const T& value);
+        //Read-modify-write under the writer lock, update gets a T& to the current value
+        template <class FUNCTION>
+        void update(FUNCTION function);
+    private:
+        static const size_t WORDS = (sizeof(T) + sizeof(uintptr_t) - 1) / sizeof(uintptr_t);
+
+        //Readers only touch this line, the writer lock lives on its own
+        CACHE_ALIGNED std::atomic<unsigned int> sequence_;
+        std::atomic<uintptr_t> words_[WORDS];
+        CACHE_ALIGNED Futex writer_;
+
+        SeqLock(const SeqLock& lock) = delete;
+        void publish(const T& value);
+        void write(const T& value);
+        T read() const;
+};
+
+
+
+template <class T>
+SeqLock<T>::SeqLock():SeqLock(T())
+{
+}
+
+template <class T>
+SeqLock<T>::SeqLock(const T& value)
+{
+    sequence_.store(0);
+    write(value);
+}
+
+template <class T>
+T SeqLock<T>::load() const
+{
+    while(true)
+    {
+        unsigned int before = sequence_.load(std::memory_order_acquire);
+        if(before & 1)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        T value = read();
+        //Orders the relaxed word loads before the second sequence read
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(sequence_.load(std::memory_order_relaxed) == before)
+            return value;
+    }
+}
+
+template <class T>
+void SeqLock<T>::store(const T& value)
+{
+    int hash = writer_.Hasher(std::this_thread::get_id());
+    writer_.lock(hash);
+    publish(value);
+    writer_.unlock(hash);
+}
+
+template <class T>
+template <class FUNCTION>
+void SeqLock<T>::update(FUNCTION function)
+{
+    int hash = writer_.Hasher(std::this_thread::get_id());
+    writer_.lock(hash);
+    //Only writers change the words and we hold the lock, so a plain read is consistent
+    T value = read();
+    function(value);
+    publish(value);
+    writer_.unlock(hash);
+}
+
+template <class T>
+void SeqLock<T>::publish(const T& value)
+{
+    unsigned int sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    //Odd sequence becomes visible before any of the new words
+    std::atomic_thread_fence(std::memory_order_release);
+    write(value);
+    sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+template <class T>
+void SeqLock<T>::write(const T& value)
+{
+    uintptr_t words[WORDS] = {};
+    memcpy(words, &value, sizeof(T));
+    for(size_t i = 0; i < WORDS; ++i)
+        words_[i].store(words[i], std::memory_order_relaxed);
+}
+
+template <class T>
+T SeqLock<T>::read() const
+{
+    uintptr_t words[WORDS];
+    for(size_t i = 0; i < WORDS; ++i)
+        words[i] = words_[i].load(std::memory_order_relaxed);
+    T value;
+    memcpy(&value, words, sizeof(T));
+    return value;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SHARDED_COUNTER_H
+#define SHARDED_COUNTER_H
+
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <CachePadded.hpp>
+
+//Statistics counter split into padded per-thread cells: add() is a relaxed fetch_add on the caller's
+//own cache line, read() sums all cells. read() is exact once adders stop and may miss the adds in
+//flight otherwise. Threads get cells round-robin, so with more threads than shards some share one.
+//shards is rounded up to a power of two.
+class ShardedCounter{
+    public:
+        explicit ShardedCounter(size_t shards = 4 * std::max(1u, std::thread::hardware_concurrency()));
+        void add(long long delta = 1);
+        long long read() const;
+        size_t shards() const;
+        //Small dense id of the calling thread, shared by all counters
+        static size_t threadIndex();
+    private:
+        size_t shards_;
+        std::unique_ptr<CachePadded<std::atomic<long long>>[]> cells_;
+        ShardedCounter(const ShardedCounter& counter) = delete;
+};
+
+//Counts up to limit without a global lock. Threads reserve batch units at a time from a shared
+//remainder into their own cell and spend them locally, once the remainder is gone they steal what
+//other cells still hold. Every tryAdd() that returns true is one of exactly limit successful adds.
+class ThresholdCounter{
+    public:
+        ThresholdCounter(long long limit, long long batch = 1024,
+                         size_t shards = 4 * std::max(1u, std::thread::hardware_concurrency()));
+        bool tryAdd();
+        //Adds done so far, exact once adders stop
+        long long read() const;
+        long long limit() const;
+    private:
+        size_t shards_;
+        std::unique_ptr<CachePadded<std::atomic<long long>>[]> budgets_;
+        long long limit_;
+        long long batch_;
+        CachePadded<std::atomic<long long>> remaining_;
+        ThresholdCounter(const ThresholdCounter& counter) = delete;
+        long long reserve();
+        long long steal(size_t thief);
+};
+
+#endif
@@ -1,18 +1,33 @@
 #include <iostream>
+#include <algorithm>
 #include <thread>
 #include <vector>
 #include <iterator>
 #include <limits>
 #include <futex.h>
+#include <shardedcounter.h>
+#include <seqlock.h>
 #include <mutex>
 #include <pthread.h>
 #include <chrono>
+#include <atomic>
+#include <memory>
+#include <CachePadded.hpp>
+#include <CpuTopology.hpp>
+#include <BenchmarkReport.hpp>
+#include <cstdlib>
+#include <string>
 
 long long MAX_SUM = 500000000;
 long long  global = 0;
 Futex futex;
 std::mutex mutex;
 pthread_mutex_t pmutex = PTHREAD_MUTEX_INITIALIZER;
+//Lock-free replacements for global, rebuilt by every run
+std::unique_ptr<ShardedCounter> sharded;
+std::unique_ptr<ThresholdCounter> threshold;
+size_t runningThreads = 1;
+std::atomic<size_t> startedThreads(0);
 int incrementFutex(long long& localSum)
 {
     int myHash = futex.Hasher(std::this_thread::get_id());
@@ -62,45 +77,285 @@ int incrementPMutex(long long& localSum)
     }
     return 0;
 }
-void run(int increment(long long& localSum), size_t numberOfThreads)
+//Nothing to check against while counting, so every thread adds its own share of MAX_SUM
+int incrementSharded(long long& localSum)
 {
+    size_t index = startedThreads.fetch_add(1);
+    long long share = MAX_SUM / runningThreads + (index < MAX_SUM % runningThreads ? 1 : 0);
+    for(; localSum < share; ++localSum)
+        sharded->add();
+    return 0;
+}
+int incrementThreshold(long long& localSum)
+{
+    while(threshold->tryAdd())
+        ++localSum;
+    return 0;
+}
+//One thread per physical core while there are enough of them, so lock handoffs are not skewed by
+//SMT siblings sharing a core, then compact wrap-around for the oversubscribed runs
+std::vector<int> pinning(size_t numberOfThreads)
+{
+    const CpuTopology& topology = CpuTopology::instance();
+    return topology.placement(numberOfThreads <= topology.cores() ? CpuTopology::ONE_PER_CORE : CpuTopology::COMPACT,
+                              numberOfThreads);
+}
+double measure(int increment(long long& localSum), std::vector<CachePadded<long long>>& local)
+{
+    size_t numberOfThreads = local.size();
     global = 0;
+    sharded.reset(new ShardedCounter());
+    threshold.reset(new ThresholdCounter(MAX_SUM));
+    runningThreads = numberOfThreads;
+    startedThreads.store(0);
     std::chrono::time_point<std::chrono::system_clock> start, end;
-    std::vector<long long> local(numberOfThreads, 0);
     std::vector<std::thread*> threads(numberOfThreads);
+    auto placement = pinning(numberOfThreads);
     start = std::chrono::system_clock::now();
     for(int i = 0; i < numberOfThreads; ++i)
-        threads[i]= new std::thread(increment, std::ref(local[i]));
+    {
+        threads[i]= new std::thread(increment, std::ref(local[i].value));
+        CpuTopology::pin(*threads[i], placement[i]);
+    }
     for(int i = 0; i < numberOfThreads; ++i)
+    {
         threads[i]->join();
+        delete threads[i];
+    }
     end = std::chrono::system_clock::now();
     std::chrono::duration<double> elapsed = end-start;
+    return elapsed.count();
+}
+void run(const std::string& name, int increment(long long& localSum), size_t numberOfThreads)
+{
+    //Threads take turns under the lock, padding keeps each one's counter from dragging its neighbours' line along
+    std::vector<CachePadded<long long>> local(numberOfThreads);
+    double elapsed = measure(increment, local);
     long long sum = 0;
     for(int i = 0; i < numberOfThreads; ++i)
     {
-        sum += local[i];
-        std::cout << i << ": " << local[i] << std::endl;
+        sum += *local[i];
+        std::cout << i << ": " << *local[i] << std::endl;
     }
     std::cout << "Sum: " << sum << std::endl;
-    std::cout << "Elapsed time: " << elapsed.count() << std::endl;
+    std::cout << "Elapsed time: " << elapsed << std::endl;
+    if(numberOfThreads > 0)
+        BenchmarkReport::record("futex/" + name + "/threads=" + std::to_string(numberOfThreads), elapsed, "s",
+                                BenchmarkReport::LOWER);
+}
+
+//Millions of increments per second for 1, 2, 4... threads, up to maxThreads
+void runScaling(size_t maxThreads)
+{
+    long long maxSum = MAX_SUM;
+    MAX_SUM = std::min(MAX_SUM, 100000000LL);
+    const char* names[] = {"futex", "sharded", "threshold"};
+    int (*increments[])(long long& localSum) = {&incrementFutex, &incrementSharded, &incrementThreshold};
+    std::cout << "threads\tfutex\tsharded\tthreshold" << std::endl;
+    for(size_t nThreads = 1; ; nThreads = std::min(nThreads * 2, maxThreads))
+    {
+        std::cout << nThreads;
+        for(int i = 0; i < 3; ++i)
+        {
+            std::vector<CachePadded<long long>> local(nThreads);
+            double mops = MAX_SUM / measure(increments[i], local) / 1e6;
+            std::cout << "\t" << mops;
+            BenchmarkReport::record(std::string("futex/scaling/") + names[i] + "/threads=" + std::to_string(nThreads),
+                                    mops, "Mops/s");
+        }
+        std::cout << std::endl;
+        if(nThreads == maxThreads)
+            break;
+    }
+    std::cout << std::endl;
+    MAX_SUM = maxSum;
+}
+
+//Threads bump private counters without any lock, the layouts only differ in false sharing
+const long long COUNTER_INCREMENTS = 100000000;
+struct PackedCounter
+{
+    std::atomic<long long> value;
+};
+template <class COUNTER>
+double runCounters(size_t numberOfThreads)
+{
+    std::vector<COUNTER> counters(numberOfThreads);
+    std::vector<std::thread*> threads(numberOfThreads);
+    auto placement = pinning(numberOfThreads);
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < numberOfThreads; ++i)
+    {
+        threads[i] = new std::thread([&counters, i](){
+            for(long long j = 0; j < COUNTER_INCREMENTS; ++j)
+                counters[i].value.fetch_add(1, std::memory_order_relaxed);
+        });
+        CpuTopology::pin(*threads[i], placement[i]);
+    }
+    for(int i = 0; i < numberOfThreads; ++i)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+void runPadding(size_t nThreads)
+{
+    double packed = runCounters<PackedCounter>(nThreads);
+    double padded = runCounters<CachePadded<std::atomic<long long>>>(nThreads);
+    std::cout << "Per-thread counters, packed: " << packed << std::endl;
+    std::cout << "Per-thread counters, CachePadded: " << padded << std::endl;
+    BenchmarkReport::record("futex/padding/packed/threads=" + std::to_string(nThreads), packed, "s", BenchmarkReport::LOWER);
+    BenchmarkReport::record("futex/padding/padded/threads=" + std::to_string(nThreads), padded, "s", BenchmarkReport::LOWER);
+    std::cout << std::endl;
+}
+
+//Routing table stand-in: every field derives from version, so a torn read shows up as a mismatch
+struct Snapshot
+{
+    long long version;
+    long long fields[7];
+};
+const std::chrono::milliseconds SNAPSHOT_DURATION(500);
+const std::chrono::microseconds WRITE_INTERVAL(100);
+Snapshot makeSnapshot(long long version)
+{
+    Snapshot snapshot;
+    snapshot.version = version;
+    for(int i = 0; i < 7; ++i)
+        snapshot.fields[i] = version * (i + 2);
+    return snapshot;
+}
+bool consistent(const Snapshot& snapshot)
+{
+    for(int i = 0; i < 7; ++i)
+        if(snapshot.fields[i] != snapshot.version * (i + 2))
+            return false;
+    return true;
+}
+//Readers load the snapshot nonstop while one writer replaces it every WRITE_INTERVAL, returns Mreads/s
+template <class LOAD, class STORE>
+double runSnapshot(LOAD load, STORE store, size_t readers, long long& torn)
+{
+    std::atomic<bool> stop(false);
+    std::vector<CachePadded<long long>> reads(readers), torns(readers);
+    std::vector<std::thread*> threads;
+    auto placement = pinning(readers + 1);
+    threads.push_back(new std::thread([&stop, &store](){
+        for(long long version = 1; !stop.load(std::memory_order_relaxed); ++version)
+        {
+            store(makeSnapshot(version));
+            std::this_thread::sleep_for(WRITE_INTERVAL);
+        }
+    }));
+    for(size_t i = 0; i < readers; ++i)
+        threads.push_back(new std::thread([&stop, &load, &reads, &torns, i](){
+            while(!stop.load(std::memory_order_relaxed))
+            {
+                if(!consistent(load()))
+                    ++*torns[i];
+                ++*reads[i];
+            }
+        }));
+    for(size_t i = 0; i < threads.size(); ++i)
+        CpuTopology::pin(*threads[i], placement[i]);
+    std::this_thread::sleep_for(SNAPSHOT_DURATION);
+    stop.store(true);
+    long long total = 0;
+    for(size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+    for(size_t i = 0; i < readers; ++i)
+    {
+        total += *reads[i];
+        torn += *torns[i];
+    }
+    return total / std::chrono::duration<double>(SNAPSHOT_DURATION).count() / 1e6;
+}
+//Reader throughput for 1, 2, 4... readers up to maxReaders, each with a concurrent writer
+void runSeqLock(size_t maxReaders)
+{
+    SeqLock<Snapshot> seqLock(makeSnapshot(0));
+    Snapshot guarded = makeSnapshot(0);
+    Futex snapshotFutex;
+    std::mutex snapshotMutex;
+    long long torn = 0;
+    std::cout << "readers\tseqlock\tfutex\tstd::mutex" << std::endl;
+    for(size_t nReaders = 1; ; nReaders = std::min(nReaders * 2, maxReaders))
+    {
+        double reads[3];
+        reads[0] = runSnapshot([&seqLock](){ return seqLock.load(); },
+                               [&seqLock](const Snapshot& snapshot){ seqLock.store(snapshot); }, nReaders, torn);
+        reads[1] = runSnapshot([&](){
+                                   int hash = snapshotFutex.Hasher(std::this_thread::get_id());
+                                   snapshotFutex.lock(hash);
+                                   Snapshot snapshot = guarded;
+                                   snapshotFutex.unlock(hash);
+                                   return snapshot;
+                               },
+                               [&](const Snapshot& snapshot){
+                                   int hash = snapshotFutex.Hasher(std::this_thread::get_id());
+                                   snapshotFutex.lock(hash);
+                                   guarded = snapshot;
+                                   snapshotFutex.unlock(hash);
+                               }, nReaders, torn);
+        reads[2] = runSnapshot([&](){
+                                   std::lock_guard<std::mutex> lock(snapshotMutex);
+                                   return guarded;
+                               },
+                               [&](const Snapshot& snapshot){
+                                   std::lock_guard<std::mutex> lock(snapshotMutex);
+                                   guarded = snapshot;
+                               }, nReaders, torn);
+        const char* names[] = {"seqlock", "futex", "mutex"};
+        std::cout << nReaders;
+        for(int i = 0; i < 3; ++i)
+        {
+            std::cout << "\t" << reads[i];
+            BenchmarkReport::record(std::string("futex/snapshot/") + names[i] + "/readers=" + std::to_string(nReaders),
+                                    reads[i], "Mreads/s");
+        }
+        std::cout << std::endl;
+        if(nReaders == maxReaders)
+            break;
+    }
+    std::cout << "Torn reads: " << torn << std::endl;
+    std::cout << std::endl;
 }
 
 void runTests(size_t nThreads)
 {
     std::cout << "Futex:" << std::endl;
-    run(&incrementFutex, nThreads);
+    run("futex", &incrementFutex, nThreads);
     std::cout << "Pthread Mutex:" << std::endl;
-    run(&incrementPMutex, nThreads);
+    run("pmutex", &incrementPMutex, nThreads);
     std::cout << "std::mutex:" << std::endl;
-    run(&incrementMutex, nThreads);
+    run("mutex", &incrementMutex, nThreads);
+    std::cout << "ShardedCounter:" << std::endl;
+    run("sharded", &incrementSharded, nThreads);
+    std::cout << "ThresholdCounter:" << std::endl;
+    run("threshold", &incrementThreshold, nThreads);
     std::cout << std::endl;
 }
 
-int main()
+//Optional argument: MAX_SUM, to shorten the lock runs
+int main(int argc, char** argv)
 {
+    if(argc > 1)
+        MAX_SUM = std::atoll(argv[1]);
+    std::cout << CpuTopology::instance().describe() << std::endl << std::endl;
     std::cout << "std::thread::hardware_concurrency() / 2:" << std::endl << std::endl;
     runTests(std::thread::hardware_concurrency() / 2);
     std::cout << "std::thread::hardware_concurrency() * 2:" << std::endl << std::endl;
     runTests(std::thread::hardware_concurrency() * 2);
+    std::cout << "False sharing, std::thread::hardware_concurrency() threads:" << std::endl << std::endl;
+    runPadding(std::max(2u, std::thread::hardware_concurrency()));
+    std::cout << "Counter scaling, Mops/s:" << std::endl << std::endl;
+    runScaling(std::max(2u, std::thread::hardware_concurrency() * 2));
+    std::cout << "Snapshot readers with a concurrent writer, Mreads/s:" << std::endl << std::endl;
+    runSeqLock(std::max(1u, std::thread::hardware_concurrency()));
     return 0;
 }
@@ -4,16 +4,21 @@
 
 Futex::Futex()
 {
-    ownerId_.store(Hasher(std::this_thread::get_id()));
-    hash0_ = Hasher(std::this_thread::get_id());
+    ownerId_.store(FREE);
+}
+
+//A thread whose hash happens to be FREE is stored as 1, threads sharing a hash only confuse unlock()
+int Futex::owner(int hash)
+{
+    return hash == FREE ? 1 : hash;
 }
 
 bool Futex::lock(int hash)
 {
-    uint8_t desired = hash0_;
-    while(!ownerId_.compare_exchange_strong(desired, hash, std::memory_order_acquire))
+    int desired = FREE;
+    while(!ownerId_.compare_exchange_strong(desired, owner(hash), std::memory_order_acquire))
     {
-        desired = hash0_;
+        desired = FREE;
         std::this_thread::yield();  //Опыт показывает, что вызывать yield каждый раз выгоднее, чем каждый 2-ой, 5-й или 10-й
                                     //(Как под gcc, так и под clang)
     }
@@ -21,8 +26,8 @@ bool Futex::lock(int hash)
 }
 bool Futex::unlock(int hash)
 {
-    uint8_t desired = hash;
-    if(!ownerId_.compare_exchange_strong(desired, hash0_))
+    int desired = owner(hash);
+    if(!ownerId_.compare_exchange_strong(desired, FREE, std::memory_order_release))
         return false;
     return true;
 }
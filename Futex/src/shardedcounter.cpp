@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cstdint>
+#include <shardedcounter.h>
+
+
+//Power of two, so picking a cell is a mask instead of a division on every add
+static size_t roundShards(size_t shards)
+{
+    size_t rounded = 1;
+    while(rounded < shards)
+        rounded *= 2;
+    return rounded;
+}
+
+ShardedCounter::ShardedCounter(size_t shards):shards_(roundShards(shards))
+{
+    cells_.reset(new CachePadded<std::atomic<long long>>[shards_]);
+    for(size_t i = 0; i < shards_; ++i)
+        cells_[i]->store(0);
+}
+
+void ShardedCounter::add(long long delta)
+{
+    cells_[threadIndex() & (shards_ - 1)]->fetch_add(delta, std::memory_order_relaxed);
+}
+
+long long ShardedCounter::read() const
+{
+    long long sum = 0;
+    for(size_t i = 0; i < shards_; ++i)
+        sum += cells_[i]->load(std::memory_order_relaxed);
+    return sum;
+}
+
+size_t ShardedCounter::shards() const
+{
+    return shards_;
+}
+
+size_t ShardedCounter::threadIndex()
+{
+    //Constant initializer, so reading it needs no TLS init check
+    static std::atomic<size_t> next(0);
+    thread_local size_t index = SIZE_MAX;
+    if(index == SIZE_MAX)
+        index = next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+
+ThresholdCounter::ThresholdCounter(long long limit, long long batch, size_t shards):shards_(roundShards(shards)),
+    limit_(limit), batch_(std::max(batch, 1LL))
+{
+    budgets_.reset(new CachePadded<std::atomic<long long>>[shards_]);
+    remaining_->store(limit);
+    for(size_t i = 0; i < shards_; ++i)
+        budgets_[i]->store(0);
+}
+
+bool ThresholdCounter::tryAdd()
+{
+    size_t shard = ShardedCounter::threadIndex() & (shards_ - 1);
+    std::atomic<long long>& budget = *budgets_[shard];
+    long long left = budget.load(std::memory_order_relaxed);
+    while(left > 0)
+    {
+        if(budget.compare_exchange_weak(left, left - 1, std::memory_order_relaxed))
+            return true;
+    }
+    long long taken = reserve();
+    if(taken == 0)
+        taken = steal(shard);
+    if(taken == 0)
+        return false;
+    //One unit is spent right away, the rest stays in the cell for the next calls
+    if(taken > 1)
+        budget.fetch_add(taken - 1, std::memory_order_relaxed);
+    return true;
+}
+
+long long ThresholdCounter::read() const
+{
+    long long unspent = remaining_->load(std::memory_order_relaxed);
+    for(size_t i = 0; i < shards_; ++i)
+        unspent += budgets_[i]->load(std::memory_order_relaxed);
+    return limit_ - unspent;
+}
+
+long long ThresholdCounter::limit() const
+{
+    return limit_;
+}
+
+long long ThresholdCounter::reserve()
+{
+    long long left = remaining_->load(std::memory_order_relaxed);
+    while(left > 0)
+    {
+        long long taken = std::min(left, batch_);
+        if(remaining_->compare_exchange_weak(left, left - taken, std::memory_order_relaxed))
+            return taken;
+    }
+    return 0;
+}
+
+long long ThresholdCounter::steal(size_t thief)
+{
+    for(size_t i = 1; i < shards_; ++i)
+    {
+        std::atomic<long long>& victim = *budgets_[(thief + i) % shards_];
+        if(victim.load(std::memory_order_relaxed) > 0)
+        {
+            long long stolen = victim.exchange(0, std::memory_order_relaxed);
+            if(stolen > 0)
+                return stolen;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "LockFreeStack.hpp"
+#include "LockFreeQueue.hpp"
+#include "BenchmarkReport.hpp"
+#include "CpuTopology.hpp"
+#include <algorithm>
+#include <mutex>
+#include <stack>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <chrono>
+
+const int OPERATIONS = 4000000;
+
+//The mutex the lock-free structures replace
+class LockedStack
+{
+    public:
+        bool Pop(int& data)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if(stack_.empty())
+                return false;
+            data = stack_.top();
+            stack_.pop();
+            return true;
+        }
+        void Push(int data)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stack_.push(data);
+        }
+    private:
+        std::mutex mutex_;
+        std::stack<int> stack_;
+};
+
+//One thread per physical core while there are enough, then compact wrap-around
+std::vector<int> pinning(size_t numberOfThreads)
+{
+    const CpuTopology& topology = CpuTopology::instance();
+    return topology.placement(numberOfThreads <= topology.cores() ? CpuTopology::ONE_PER_CORE : CpuTopology::COMPACT,
+                              numberOfThreads);
+}
+
+//Every thread alternates Push and Pop, OPERATIONS / numberOfThreads pairs each, so head_ (and tail_)
+//and the node free list are contended from every core
+template <class STRUCTURE>
+double run(unsigned int numberOfThreads)
+{
+    STRUCTURE structure;
+    std::vector<std::thread*> threads;
+    auto placement = pinning(numberOfThreads);
+    std::chrono::time_point<std::chrono::steady_clock> start, end;
+    start = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < numberOfThreads; ++i)
+    {
+        threads.push_back(new std::thread([&structure, numberOfThreads](){
+            int item;
+            for(unsigned int j = 0; j < OPERATIONS / numberOfThreads; ++j)
+            {
+                structure.Push(j);
+                structure.Pop(item);
+            }
+        }));
+        CpuTopology::pin(*threads.back(), placement[i]);
+    }
+    for(auto th: threads)
+    {
+        th->join();
+        delete th;
+    }
+    end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    return 2.0 * (OPERATIONS / numberOfThreads) * numberOfThreads / elapsed.count();
+}
+
+int main()
+{
+    unsigned int maxThreads = std::max(2u, 2 * std::thread::hardware_concurrency());
+    const char* layout = sizeof(CachePadded<char>) == 1 ? "unpadded" : "padded";
+    std::cout << "layout: " << layout << std::endl;
+    std::cout << "threads\tmutex (std::stack)\tLockFreeStack\tLockFreeQueue\t[operations/s]" << std::endl;
+    for(unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        double results[] = {run<LockedStack>(threads), run<LockFreeStack<int>>(threads), run<LockFreeQueue<int>>(threads)};
+        const char* names[] = {"mutex", "stack", "queue"};
+        std::cout << threads;
+        for(int i = 0; i < 3; ++i)
+        {
+            std::cout << "\t" << results[i];
+            BenchmarkReport::record(std::string("lockfreestack/throughput/") + layout + "/" + names[i] + "/threads=" +
+                                    std::to_string(threads), results[i], "operations/s");
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
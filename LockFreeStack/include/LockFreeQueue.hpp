@@ -0,0 +1,156 @@
+#ifndef C_LOCK_FREE_QUEUE_H
+#define C_LOCK_FREE_QUEUE_H
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <TaggedPointer.hpp>
+#include <CachePadded.hpp>
+
+//Michael & Scott lock-free FIFO with tagged pointers and a type-stable node pool:
+//nodes are recycled through a free list and deleted only with the queue, so a thread that
+//still reads a dequeued node sees valid memory and its CAS fails on the tag.
+template <typename ValueType>
+class LockFreeQueue
+{
+    public:
+        LockFreeQueue();
+        ~LockFreeQueue();
+        bool Pop(ValueType& data);
+        void Push(ValueType data);
+    private:
+        struct Node
+        {
+            Node():refs(0), freeNext(nullptr) { next.store(TaggedPointer<Node>()); }
+            ValueType* Value() { return reinterpret_cast<ValueType*>(&storage); }
+
+            std::atomic<TaggedPointer<Node>> next;
+            //A node is freed once it has been unlinked as the sentinel and its value has been
+            //moved out, which may happen in either order on different threads
+            std::atomic<int> refs;
+            std::atomic<Node*> freeNext;
+            typename std::aligned_storage<sizeof(ValueType), alignof(ValueType)>::type storage;
+        };
+
+        Node* Allocate();
+        void Release(Node* node);
+
+        //Consumers CAS head_, producers tail_, both sides free_
+        CACHE_ALIGNED std::atomic<TaggedPointer<Node>> head_;
+        CACHE_ALIGNED std::atomic<TaggedPointer<Node>> tail_;
+        CACHE_ALIGNED std::atomic<TaggedPointer<Node>> free_;
+        LockFreeQueue(const LockFreeQueue& queue) = delete;
+};
+
+
+
+template <typename ValueType>
+LockFreeQueue<ValueType>::LockFreeQueue()
+{
+    Node* sentinel = new Node();
+    sentinel->refs.store(1);
+    head_.store(TaggedPointer<Node>(sentinel, 0));
+    tail_.store(TaggedPointer<Node>(sentinel, 0));
+    free_.store(TaggedPointer<Node>());
+}
+
+template <typename ValueType>
+LockFreeQueue<ValueType>::~LockFreeQueue()
+{
+    Node* pointer = head_.load().Pointer();
+    Node* next = pointer->next.load().Pointer();
+    delete pointer;
+    while(next != nullptr)
+    {
+        pointer = next;
+        next = pointer->next.load().Pointer();
+        pointer->Value()->~ValueType();
+        delete pointer;
+    }
+    pointer = free_.load().Pointer();
+    while(pointer != nullptr)
+    {
+        next = pointer->freeNext.load();
+        delete pointer;
+        pointer = next;
+    }
+}
+
+template <typename ValueType>
+bool LockFreeQueue<ValueType>::Pop(ValueType& data)
+{
+    while(true)
+    {
+        auto head = head_.load();
+        auto tail = tail_.load();
+        auto next = head.Pointer()->next.load();
+        if(head != head_.load())
+            continue;
+        if(head.Pointer() == tail.Pointer())
+        {
+            if(next.Pointer() == nullptr)
+                return false;
+            tail_.compare_exchange_strong(tail, tail.Replace(next.Pointer()));
+        }
+        else if(next.Pointer() != nullptr && head_.compare_exchange_strong(head, head.Replace(next.Pointer())))
+        {
+            //next is the new sentinel, it cannot be recycled before we release it
+            Node* node = next.Pointer();
+            data = std::move(*node->Value());
+            node->Value()->~ValueType();
+            Release(node);
+            Release(head.Pointer());
+            return true;
+        }
+    }
+}
+
+template <typename ValueType>
+void LockFreeQueue<ValueType>::Push(ValueType data)
+{
+    Node* node = Allocate();
+    new (node->Value()) ValueType(std::move(data));
+    node->refs.store(2);
+    node->next.store(node->next.load().Replace(nullptr));
+    TaggedPointer<Node> tail;
+    while(true)
+    {
+        tail = tail_.load();
+        auto next = tail.Pointer()->next.load();
+        if(tail != tail_.load())
+            continue;
+        if(next.Pointer() == nullptr)
+        {
+            if(tail.Pointer()->next.compare_exchange_strong(next, next.Replace(node)))
+                break;
+        }
+        else
+            tail_.compare_exchange_strong(tail, tail.Replace(next.Pointer()));
+    }
+    tail_.compare_exchange_strong(tail, tail.Replace(node));
+}
+
+template <typename ValueType>
+typename LockFreeQueue<ValueType>::Node* LockFreeQueue<ValueType>::Allocate()
+{
+    auto a = free_.load();
+    do{
+           if(a.Pointer() == nullptr)
+               return new Node();
+    }while(!free_.compare_exchange_strong(a, a.Replace(a.Pointer()->freeNext.load())));
+    return a.Pointer();
+}
+
+template <typename ValueType>
+void LockFreeQueue<ValueType>::Release(Node* node)
+{
+    if(--node->refs != 0)
+        return;
+    auto a = free_.load();
+    do{
+           node->freeNext.store(a.Pointer());
+    }while(!free_.compare_exchange_strong(a, a.Replace(node)));
+}
+
+#endif
@@ -3,8 +3,11 @@
 
 #include <assert.h>
 #include <atomic>
+#include <utility>
 #include <vector>
 #include <iostream>
+#include <TaggedPointer.hpp>
+#include <CachePadded.hpp>
 
 #ifdef TEST_LOCK_FREE_STACK
 #include <Logger.h>
@@ -30,6 +33,7 @@ struct atomwrapper
   atomwrapper &operator=(const atomwrapper &other)
   {
     _a.store(other._a.load());
+    return *this;
   }
 };
 #endif
@@ -50,8 +54,9 @@ class LockFreeStack
     private:
         struct Node
         {
-            Node(Node* next, ValueType data):next(next), data(data) {}
-            Node* next;
+            Node(Node* next, ValueType data):next(next), data(std::move(data)) {}
+            //Atomic because Pop may read it from a node another thread has just popped
+            std::atomic<Node*> next;
             ValueType data;
         };
         class IAllocator
@@ -78,18 +83,24 @@ class LockFreeStack
 
         };
 #endif
+        //Freed nodes go to a lock-free free list and are only deleted with the stack:
+        //Pop may still dereference a node another thread has popped, so nodes must stay valid
         class DefaultMalloc:public IAllocator
         {
             public:
-                DefaultMalloc() {}
-                ~DefaultMalloc(){}
-                Node* Malloc(Node* next, ValueType data) { return new Node(next, data);}
-                void Free(Node* node){delete node;}
+                DefaultMalloc() { free_.store(TaggedPointer<Node>()); }
+                ~DefaultMalloc();
+                Node* Malloc(Node* next, ValueType data);
+                void Free(Node* node);
                 void Initialize(unsigned int size){};
+            private:
+                //Off the line of the vtable pointer every Malloc/Free call reads
+                CACHE_ALIGNED std::atomic<TaggedPointer<Node>> free_;
 
         };
-        std::atomic<Node*> head_;
-        IAllocator* allocator;
+        //Every CAS on head_ would otherwise invalidate the allocator pointer all Push/Pop calls read
+        CACHE_ALIGNED std::atomic<TaggedPointer<Node>> head_;
+        CACHE_ALIGNED IAllocator* allocator;
 };
 
 
@@ -106,27 +117,28 @@ LockFreeStack<ValueType>::LockFreeStack(MallocType type, unsigned int size)
         case MallocType::DEFAULT:
             allocator = new DefaultMalloc();
             break;
+#ifdef TEST_LOCK_FREE_STACK
         case MallocType::CUSTOM:
             allocator = new CustomMalloc();
             allocator->Initialize(size);
             break;
+#endif
         default:
             break;
     }
 
-    head_.store(nullptr);
+    head_.store(TaggedPointer<Node>());
 }
 
 template <typename ValueType>
 LockFreeStack<ValueType>::~LockFreeStack()
 {
-    auto pointer = head_.load();
+    auto pointer = head_.load().Pointer();
     while(pointer != nullptr)
     {
-        auto oldHead = pointer;
-        pointer = pointer->next;
+        auto next = pointer->next.load();
         allocator->Free(pointer);
-        pointer = oldHead;
+        pointer = next;
     }
     delete allocator;
 }
@@ -136,21 +148,54 @@ bool LockFreeStack<ValueType>::Pop(ValueType& data)
 {
     auto a = head_.load();
     do{
-           if(a == nullptr)
+           if(a.Pointer() == nullptr)
                return false;
-    }while(!head_.compare_exchange_strong(a, a->next));
-    if(a == nullptr)
-        return false;
-    data = a->data;
-    allocator->Free(a);;
+    }while(!head_.compare_exchange_strong(a, a.Replace(a.Pointer()->next.load())));
+    data = std::move(a.Pointer()->data);
+    allocator->Free(a.Pointer());
     return true;
 }
 
 template <typename ValueType>
 void LockFreeStack<ValueType>::Push(ValueType data)
 {
-    Node* node = allocator->Malloc(head_.load(), data);
-    while(!head_.compare_exchange_strong(node->next, node));
+    auto head = head_.load();
+    Node* node = allocator->Malloc(head.Pointer(), std::move(data));
+    while(!head_.compare_exchange_strong(head, head.Replace(node)))
+        node->next.store(head.Pointer());
+}
+
+template <typename ValueType>
+LockFreeStack<ValueType>::DefaultMalloc::~DefaultMalloc()
+{
+    auto pointer = free_.load().Pointer();
+    while(pointer != nullptr)
+    {
+        auto next = pointer->next.load();
+        delete pointer;
+        pointer = next;
+    }
+}
+template <typename ValueType>
+typename LockFreeStack<ValueType>::Node* LockFreeStack<ValueType>::DefaultMalloc::Malloc(Node* next, ValueType data)
+{
+    auto a = free_.load();
+    do{
+           if(a.Pointer() == nullptr)
+               return new Node(next, std::move(data));
+    }while(!free_.compare_exchange_strong(a, a.Replace(a.Pointer()->next.load())));
+    Node* node = a.Pointer();
+    node->next.store(next);
+    node->data = std::move(data);
+    return node;
+}
+template <typename ValueType>
+void LockFreeStack<ValueType>::DefaultMalloc::Free(Node* node)
+{
+    auto a = free_.load();
+    do{
+           node->next.store(a.Pointer());
+    }while(!free_.compare_exchange_strong(a, a.Replace(node)));
 }
 
 #ifdef TEST_LOCK_FREE_STACK
@@ -167,7 +212,7 @@ void LockFreeStack<ValueType>::CustomMalloc::Initialize(unsigned int size)
         std::atomic<bool> atom(false);
         allocIds_.push_back(atom);
     }
-    if((alloc_ = (Node*)malloc(sizeof(Node)*size)) < 0)
+    if((alloc_ = (Node*)malloc(sizeof(Node)*size)) == nullptr)
     {
         std::cerr << "Failed to alloc stack\n" << std::endl;
         exit(1);
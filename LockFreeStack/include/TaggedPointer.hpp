@@ -0,0 +1,36 @@
+#ifndef TAGGED_POINTER_H
+#define TAGGED_POINTER_H
+
+#include <assert.h>
+#include <stdint.h>
+
+//Pointer with a 16-bit modification counter packed into the unused upper bits of a 64-bit
+//user-space address. Every successful CAS installs a new tag, so a pointer that was popped,
+//freed and pushed again (ABA) no longer compares equal to a stale copy.
+template <typename T>
+class TaggedPointer
+{
+    static_assert(sizeof(uintptr_t) == 8, "TaggedPointer needs 64-bit pointers");
+    public:
+        TaggedPointer():value_(0) {}
+        TaggedPointer(T* pointer, uint16_t tag)
+            :value_(reinterpret_cast<uintptr_t>(pointer) | (uintptr_t(tag) << TAG_SHIFT))
+        {
+            assert((reinterpret_cast<uintptr_t>(pointer) & ~POINTER_MASK) == 0);
+        }
+
+        T* Pointer() const { return reinterpret_cast<T*>(value_ & POINTER_MASK); }
+        uint16_t Tag() const { return uint16_t(value_ >> TAG_SHIFT); }
+        //Copy pointing to pointer with the next tag
+        TaggedPointer Replace(T* pointer) const { return TaggedPointer(pointer, Tag() + 1); }
+
+        bool operator==(const TaggedPointer& other) const { return value_ == other.value_; }
+        bool operator!=(const TaggedPointer& other) const { return value_ != other.value_; }
+
+    private:
+        static const int TAG_SHIFT = 48;
+        static const uintptr_t POINTER_MASK = (uintptr_t(1) << TAG_SHIFT) - 1;
+        uintptr_t value_;
+};
+
+#endif
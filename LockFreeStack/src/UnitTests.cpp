@@ -1,8 +1,11 @@
 #include "LockFreeStack.hpp"
+#include "LockFreeQueue.hpp"
+#include "CpuTopology.hpp"
 #include <thread>
 #include <functional>
 #include <vector>
 #include <iostream>
+#include <memory>
 
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE LOCK_FREE_STACK_UNIT_TEST
@@ -27,6 +30,14 @@ void Consume(unsigned int items, std::vector<T>& consume, LockFreeStack<T>& stac
         consume.push_back(item);
     }
 }
+//Spread the test threads over packages and cores first, so the CAS loops really race across caches
+void Pin(std::initializer_list<std::thread*> threads)
+{
+    auto placement = CpuTopology::instance().placement(CpuTopology::SCATTER, threads.size());
+    auto cpu = placement.begin();
+    for(auto thread: threads)
+        CpuTopology::pin(*thread, *cpu++);
+}
 std::vector<int> GenerateStorage(int from, int to)
 {
     assert(from <= to);
@@ -46,6 +57,7 @@ BOOST_AUTO_TEST_CASE(LockFreeTest_default)
     auto cons1 = new std::thread(Consume<int>, 8*SIZE, std::ref(consume1), std::ref(stack));
     auto push2 = new std::thread(Produce<int>, std::ref(storage2), std::ref(stack));
     auto cons2 = new std::thread(Consume<int>, 8*SIZE, std::ref(consume2), std::ref(stack));
+    Pin({push1, cons1, push2, cons2});
     push1->join();
     delete push1;
     push2->join();
@@ -104,6 +116,7 @@ BOOST_AUTO_TEST_CASE(LockFreeTest_custom)
     auto cons1 = new std::thread(Consume<int>, 8*SIZE, std::ref(consume1), std::ref(stack));
     auto push2 = new std::thread(Produce<int>, std::ref(storage2), std::ref(stack));
     auto cons2 = new std::thread(Consume<int>, 8*SIZE, std::ref(consume2), std::ref(stack));
+    Pin({push1, cons1, push2, cons2});
     push1->join();
     delete push1;
     push2->join();
@@ -152,3 +165,84 @@ BOOST_AUTO_TEST_CASE(LockFreeTest_custom)
         BOOST_CHECK(verify[i]);
     }
 }
+BOOST_AUTO_TEST_CASE(LockFreeQueueTest)
+{
+    LockFreeQueue<int> queue;
+    auto storage1 = GenerateStorage(0, 10*SIZE);
+    auto storage2 = GenerateStorage(10*SIZE, 20*SIZE);
+    std::vector<int> consume1, consume2;
+    auto produce = [&queue](std::vector<int>& storage){
+        for(auto it = storage.begin(); it != storage.end(); ++it)
+            queue.Push(*it);
+    };
+    auto consume = [&queue](unsigned int items, std::vector<int>& consume){
+        for(unsigned int i = 0; i < items; ++i)
+        {
+            int item;
+            while(!queue.Pop(item));
+            consume.push_back(item);
+        }
+    };
+    auto push1 = new std::thread(produce, std::ref(storage1));
+    auto cons1 = new std::thread(consume, 10*SIZE, std::ref(consume1));
+    auto push2 = new std::thread(produce, std::ref(storage2));
+    auto cons2 = new std::thread(consume, 10*SIZE, std::ref(consume2));
+    Pin({push1, cons1, push2, cons2});
+    push1->join();
+    delete push1;
+    push2->join();
+    delete push2;
+    cons1->join();
+    delete cons1;
+    cons2->join();
+    delete cons2;
+    int item;
+    BOOST_CHECK(!queue.Pop(item));
+    std::vector<bool> verify(20*SIZE, false);
+    for(auto consumed: {&consume1, &consume2})
+    {
+        int last[2] = {-1, -1};
+        for(auto it = consumed->begin(); it != consumed->end(); ++it)
+        {
+            if(verify[*it])
+            {
+                std::cout << "Fail on verify - already true:" << *it << std::endl;
+            }
+            BOOST_CHECK(!verify[*it]);
+            verify[*it] = true;
+            int producer = *it < 10*SIZE ? 0 : 1;
+            if(*it < last[producer])
+            {
+                std::cout << "Out of order:" << *it << " after " << last[producer] << std::endl;
+            }
+            BOOST_CHECK(*it > last[producer]);
+            last[producer] = *it;
+        }
+    }
+    for(int i = 0; i < verify.size(); ++i)
+    {
+        if(!verify[i])
+        {
+            std::cout << "Lost element:" << i << std::endl;
+        }
+        BOOST_CHECK(verify[i]);
+    }
+}
+BOOST_AUTO_TEST_CASE(LockFreeDestroyNonEmpty)
+{
+    auto counter = std::make_shared<int>(0);
+    {
+        LockFreeStack<std::shared_ptr<int>> stack;
+        LockFreeQueue<std::shared_ptr<int>> queue;
+        for(int i = 0; i < 100; ++i)
+        {
+            stack.Push(counter);
+            queue.Push(counter);
+        }
+        std::shared_ptr<int> item;
+        BOOST_CHECK(stack.Pop(item));
+        BOOST_CHECK(queue.Pop(item));
+        BOOST_CHECK(counter.use_count() == 2 + 99 + 99);
+    }
+    BOOST_CHECK(counter.use_count() == 1);
+}
@@ -1,9 +1,5 @@
 #!/bin/sh
-echo test > test_res.txt
-for i in `seq 1 20`;
-do
-    echo 'pingpong:' >> test_res.txt
-    (time ./pingpong) &>> test_res.txt
-    echo 'nopingpong:' >> test_res.txt
-    (time ./nopingpong) &>> test_res.txt
-done
+#Full sweep as CSV, test_res.txt keeps the old pingpong/nopingpong timings for reference
+(lscpu 2>/dev/null || cat /proc/cpuinfo) > results_cpuinfo.txt
+./pingpong --threads 2,4 --stride 0,1,64,128,1024 --offset 0,32 \
+    --pinning none,core,smt,socket,cross --repeat 5 "$@" > results.csv
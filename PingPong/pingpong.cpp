@@ -1,24 +1,384 @@
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <thread>
-#include <functional>
+#include <utility>
+#include <vector>
+#include <CpuTopology.hpp>
+#include <BenchmarkReport.hpp>
 
+//Cache-coherence sweep. Every thread owns one byte at offset + thread * stride in a page aligned
+//buffer and hammers it; stride 1 is the old pingpong (one line bouncing between cores), stride 1024
+//the old nopingpong. With read sharing thread 0 writes and the others load their own byte, so the
+//line ping-pongs between a writer and readers instead of between writers. Stride 0 makes every
+//thread hit the same byte (true sharing).
+//Prints one CSV row per configuration and repetition: ns/op is the wall time divided by the
+//iterations of one thread, cache misses and HITM are summed over all threads and left empty when
+//perf_event_open is not permitted or the event is not given.
 
-const int N = 500000000;
+enum Store
+{
+    PLAIN, RELAXED, SEQ_CST, RMW
+};
+const char* STORE_NAMES[] = {"plain", "relaxed", "seqcst", "rmw"};
+
+enum Sharing
+{
+    WRITE, READ
+};
+const char* SHARING_NAMES[] = {"write", "read"};
+
+//none leaves placement to the scheduler, core puts every thread on one logical CPU,
+//smt on hyperthreads of one core, socket on different cores of one package,
+//cross spreads threads over packages
+enum Pinning
+{
+    NONE, CORE, SMT, SOCKET, CROSS
+};
+const char* PINNING_NAMES[] = {"none", "core", "smt", "socket", "cross"};
+
+struct Config
+{
+    int threads;
+    size_t stride;
+    size_t offset;
+    Store store;
+    Sharing sharing;
+    Pinning pinning;
+};
+
+struct Options
+{
+    std::vector<int> threads = {2};
+    std::vector<size_t> strides = {1, 64, 128, 1024};
+    std::vector<size_t> offsets = {0};
+    std::vector<Store> stores = {PLAIN, RELAXED, SEQ_CST, RMW};
+    std::vector<Sharing> sharings = {WRITE, READ};
+    std::vector<Pinning> pinnings = {NONE};
+    long long iterations = 50000000;
+    int repeat = 1;
+    //Raw PMU config for HITM loads, e.g. 0x04d2 (MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM on Skylake)
+    uint64_t hitm = 0;
+};
+
+struct Counters
+{
+    long long cacheMisses = -1;
+    long long hitm = -1;
+};
+
+//Logical CPU for every thread, empty when the machine has no such placement
+std::vector<int> place(const CpuTopology& topology, Pinning pinning, int threads)
+{
+    int first = topology.placement(CpuTopology::COMPACT, 1)[0];
+    if(pinning == CORE)
+        return std::vector<int>(threads, first);
+    std::vector<int> placement;
+    if(pinning == SMT)
+    {
+        for(int cpu: topology.smtSiblings(first))
+            if(topology.allowed(cpu))
+                placement.push_back(cpu);
+    }
+    else if(pinning == SOCKET)
+    {
+        for(int cpu: topology.placement(CpuTopology::ONE_PER_CORE, topology.cores()))
+            if(topology.cpu(cpu)->package == topology.cpu(first)->package)
+                placement.push_back(cpu);
+    }
+    else if(topology.packages() > 1)
+    {
+        //First logical CPU of every physical core, alternating between packages
+        for(int cpu: topology.placement(CpuTopology::SCATTER, topology.cpus().size()))
+            if(topology.smtSiblings(cpu).front() == cpu && topology.allowed(cpu))
+                placement.push_back(cpu);
+    }
+    if(placement.size() < size_t(threads))
+        return std::vector<int>();
+    placement.resize(threads);
+    return placement;
+}
+
+int openCounter(uint32_t type, uint64_t config)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+long long readCounter(int fd)
+{
+    long long value;
+    if(fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value))
+        return -1;
+    return value;
+}
+
+//Compiler barrier: keeps the plain accesses in the loop without making them atomic
+inline void barrier()
+{
+    asm volatile("" ::: "memory");
+}
+
+void hammer(unsigned char* slot, Store store, bool writer, long long iterations)
+{
+    if(writer)
+    {
+        for(long long i = 0; i < iterations; ++i)
+        {
+            switch(store)
+            {
+                case PLAIN:
+                    *slot = (unsigned char)i;
+                    barrier();
+                    break;
+                case RELAXED:
+                    __atomic_store_n(slot, (unsigned char)i, __ATOMIC_RELAXED);
+                    break;
+                case SEQ_CST:
+                    __atomic_store_n(slot, (unsigned char)i, __ATOMIC_SEQ_CST);
+                    break;
+                case RMW:
+                    __atomic_fetch_add(slot, 1, __ATOMIC_RELAXED);
+                    break;
+            }
+        }
+        return;
+    }
+    //Readers use the load matching the store kind, RMW readers load seq_cst
+    unsigned int sum = 0;
+    for(long long i = 0; i < iterations; ++i)
+    {
+        switch(store)
+        {
+            case PLAIN:
+                sum += *slot;
+                barrier();
+                break;
+            case RELAXED:
+                sum += __atomic_load_n(slot, __ATOMIC_RELAXED);
+                break;
+            case SEQ_CST:
+            case RMW:
+                sum += __atomic_load_n(slot, __ATOMIC_SEQ_CST);
+                break;
+        }
+    }
+    asm volatile("" :: "r"(sum));
+}
 
-char ping[2];
+bool run(const Config& config, const std::vector<int>& placement, const Options& options,
+         double& nsPerOp, Counters& total)
+{
+    size_t size = config.offset + config.threads * config.stride + 64;
+    void* memory;
+    if(posix_memalign(&memory, 4096, size) != 0)
+        return false;
+    memset(memory, 0, size);
+    unsigned char* buffer = static_cast<unsigned char*>(memory);
+
+    std::atomic<int> ready(0);
+    std::atomic<bool> start(false);
+    std::atomic<int> unpinned(0);
+    std::vector<Counters> counters(config.threads);
+    std::vector<std::thread*> threads;
+    for(int t = 0; t < config.threads; ++t)
+        threads.push_back(new std::thread([&, t](){
+            if(!placement.empty() && !CpuTopology::pinCurrentThread(placement[t]))
+                unpinned.fetch_add(1);
+            int misses = openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+            int hitm = options.hitm != 0 ? openCounter(PERF_TYPE_RAW, options.hitm) : -1;
+            ready.fetch_add(1);
+            while(!start.load())
+                std::this_thread::yield();
+            if(misses >= 0)
+                ioctl(misses, PERF_EVENT_IOC_ENABLE, 0);
+            if(hitm >= 0)
+                ioctl(hitm, PERF_EVENT_IOC_ENABLE, 0);
+            bool writer = config.sharing == WRITE || t == 0;
+            hammer(buffer + config.offset + t * config.stride, config.store, writer, options.iterations);
+            if(misses >= 0)
+            {
+                ioctl(misses, PERF_EVENT_IOC_DISABLE, 0);
+                counters[t].cacheMisses = readCounter(misses);
+                close(misses);
+            }
+            if(hitm >= 0)
+            {
+                ioctl(hitm, PERF_EVENT_IOC_DISABLE, 0);
+                counters[t].hitm = readCounter(hitm);
+                close(hitm);
+            }
+        }));
+    while(ready.load() != config.threads)
+        std::this_thread::yield();
+    auto begin = std::chrono::steady_clock::now();
+    start.store(true);
+    for(auto thread: threads)
+    {
+        thread->join();
+        delete thread;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    free(memory);
+    if(unpinned.load() != 0)
+        std::cerr << "warning: " << unpinned.load() << " of " << config.threads << " threads ran unpinned" << std::endl;
+
+    nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / options.iterations;
+    total = Counters();
+    for(auto& counter: counters)
+    {
+        if(counter.cacheMisses >= 0)
+            total.cacheMisses = (total.cacheMisses < 0 ? 0 : total.cacheMisses) + counter.cacheMisses;
+        if(counter.hitm >= 0)
+            total.hitm = (total.hitm < 0 ? 0 : total.hitm) + counter.hitm;
+    }
+    return true;
+}
+
+template <class T, class PARSE>
+std::vector<T> parseList(const std::string& list, PARSE parse)
+{
+    std::vector<T> values;
+    std::stringstream stream(list);
+    std::string value;
+    while(std::getline(stream, value, ','))
+        values.push_back(parse(value));
+    return values;
+}
+
+template <class T>
+T parseName(const std::string& value, const char* const* names, int count)
+{
+    for(int i = 0; i < count; ++i)
+        if(value == names[i])
+            return T(i);
+    throw std::invalid_argument("unknown value " + value);
+}
+
+void usage()
+{
+    std::cerr << "usage: pingpong [--threads 2,4] [--stride 1,64,128,1024] [--offset 0]\n"
+                 "                [--store plain,relaxed,seqcst,rmw] [--sharing write,read]\n"
+                 "                [--pinning none,core,smt,socket,cross] [--iterations N]\n"
+                 "                [--repeat N] [--hitm RAW_EVENT]" << std::endl;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    auto toInt = [](const std::string& value){ return std::stoi(value); };
+    auto toSize = [](const std::string& value){ return size_t(std::stoull(value)); };
+    try
+    {
+        for(int i = 1; i < argc; ++i)
+        {
+            std::string option = argv[i];
+            if(i + 1 >= argc)
+                return false;
+            std::string value = argv[++i];
+            if(option == "--threads")
+                options.threads = parseList<int>(value, toInt);
+            else if(option == "--stride")
+                options.strides = parseList<size_t>(value, toSize);
+            else if(option == "--offset")
+                options.offsets = parseList<size_t>(value, toSize);
+            else if(option == "--store")
+                options.stores = parseList<Store>(value, [](const std::string& name){
+                    return parseName<Store>(name, STORE_NAMES, 4);
+                });
+            else if(option == "--sharing")
+                options.sharings = parseList<Sharing>(value, [](const std::string& name){
+                    return parseName<Sharing>(name, SHARING_NAMES, 2);
+                });
+            else if(option == "--pinning")
+                options.pinnings = parseList<Pinning>(value, [](const std::string& name){
+                    return parseName<Pinning>(name, PINNING_NAMES, 5);
+                });
+            else if(option == "--iterations")
+                options.iterations = std::stoll(value);
+            else if(option == "--repeat")
+                options.repeat = std::stoi(value);
+            else if(option == "--hitm")
+                options.hitm = std::stoull(value, nullptr, 0);
+            else
+                return false;
+        }
+    }
+    catch(const std::exception& error)
+    {
+        std::cerr << error.what() << std::endl;
+        return false;
+    }
+    return true;
+}
 
-int main()
+int main(int argc, char** argv)
 {
-  auto thr1 = new std::thread([&](){
-      for(int i = 0; i < N; ++i)
-	ping[0] = i;
-    });
-  auto thr2 = new std::thread([&](){
-      for(int i = 0; i < N; ++i)
-	ping[1] = i;
-    });
-  thr1->join();
-  thr2->join();
-  delete thr1;
-  delete thr2;
-  return 0;
+    Options options;
+    if(!parseOptions(argc, argv, options))
+    {
+        usage();
+        return 1;
+    }
+    const CpuTopology& topology = CpuTopology::instance();
+    std::cerr << topology.describe() << std::endl;
+    std::cout << "threads,stride,offset,store,sharing,pinning,run,iterations,ns_per_op,cache_misses,hitm" << std::endl;
+    for(int threads: options.threads)
+        for(Pinning pinning: options.pinnings)
+        {
+            std::vector<int> placement;
+            if(pinning != NONE)
+            {
+                placement = place(topology, pinning, threads);
+                if(placement.empty())
+                {
+                    std::cerr << "skipping " << PINNING_NAMES[pinning] << " pinning for " << threads
+                              << " threads, not available on this machine" << std::endl;
+                    continue;
+                }
+            }
+            for(size_t stride: options.strides)
+                for(size_t offset: options.offsets)
+                    for(Store store: options.stores)
+                        for(Sharing sharing: options.sharings)
+                            for(int repetition = 0; repetition < options.repeat; ++repetition)
+                            {
+                                Config config = {threads, stride, offset, store, sharing, pinning};
+                                double nsPerOp;
+                                Counters counters;
+                                if(!run(config, placement, options, nsPerOp, counters))
+                                    return 1;
+                                std::cout << threads << "," << stride << "," << offset << ","
+                                          << STORE_NAMES[store] << "," << SHARING_NAMES[sharing] << ","
+                                          << PINNING_NAMES[pinning] << "," << repetition << ","
+                                          << options.iterations << "," << nsPerOp << ",";
+                                if(counters.cacheMisses >= 0)
+                                    std::cout << counters.cacheMisses;
+                                std::cout << ",";
+                                if(counters.hitm >= 0)
+                                    std::cout << counters.hitm;
+                                std::cout << std::endl;
+                                BenchmarkReport::record("pingpong/threads=" + std::to_string(threads) + "/stride=" +
+                                                        std::to_string(stride) + "/offset=" + std::to_string(offset) + "/" +
+                                                        STORE_NAMES[store] + "/" + SHARING_NAMES[sharing] + "/" +
+                                                        PINNING_NAMES[pinning], nsPerOp, "ns/op", BenchmarkReport::LOWER);
+                            }
+        }
+    return 0;
 }
@@ -0,0 +1,97 @@
+#include "StripedHashMap.hpp"
+#include "BenchmarkReport.hpp"
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <iostream>
+#include <chrono>
+
+const int KEYS = 1 << 16;
+const int OPERATIONS = 2000000;
+
+//The single lock the striped map replaces, as a CSyncContainer would wrap std::unordered_map
+class LockedMap
+{
+    public:
+        bool find(int key, int& value) const
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = map_.find(key);
+            if(it == map_.end())
+                return false;
+            value = it->second;
+            return true;
+        }
+        void assign(int key, int value)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            map_[key] = value;
+        }
+        bool erase(int key)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return map_.erase(key) != 0;
+        }
+    private:
+        mutable std::mutex mutex_;
+        std::unordered_map<int, int> map_;
+};
+
+//Threads share OPERATIONS random operations over KEYS keys, half of them present at the start.
+//readPercent of the operations are finds, the rest split evenly into assigns and erases
+template <class MAP>
+double run(MAP& map, unsigned int numberOfThreads, int readPercent)
+{
+    for(int key = 0; key < KEYS; key += 2)
+        map.assign(key, key);
+    std::vector<std::thread*> threads;
+    std::chrono::time_point<std::chrono::steady_clock> start, end;
+    start = std::chrono::steady_clock::now();
+    for(unsigned int t = 0; t < numberOfThreads; ++t)
+        threads.push_back(new std::thread([&map, t, numberOfThreads, readPercent](){
+            std::minstd_rand random(t + 1);
+            int value;
+            for(int i = 0; i < OPERATIONS / int(numberOfThreads); ++i)
+            {
+                int key = random() % KEYS;
+                int operation = random() % 100;
+                if(operation < readPercent)
+                    map.find(key, value);
+                else if(random() % 2 == 0)
+                    map.assign(key, i);
+                else
+                    map.erase(key);
+            }
+        }));
+    for(auto th: threads)
+    {
+        th->join();
+        delete th;
+    }
+    end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    return OPERATIONS / elapsed.count();
+}
+
+int main()
+{
+    unsigned int maxThreads = std::max(2u, 2 * std::thread::hardware_concurrency());
+    std::cout << "reads %\tthreads\tstd::unordered_map + std::mutex\tStripedHashMap\t[ops/s]" << std::endl;
+    for(int readPercent: {50, 90, 99})
+        for(unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+        {
+            LockedMap locked;
+            StripedHashMap<int, int> striped;
+            double lockedOps = run(locked, threads, readPercent);
+            double stripedOps = run(striped, threads, readPercent);
+            std::cout << readPercent << "\t" << threads << "\t" << lockedOps << "\t" << stripedOps << std::endl;
+            std::string suffix = "/reads=" + std::to_string(readPercent) + "/threads=" + std::to_string(threads);
+            BenchmarkReport::record("stripedhashmap/locked" + suffix, lockedOps, "ops/s");
+            BenchmarkReport::record("stripedhashmap/striped" + suffix, stripedOps, "ops/s");
+        }
+    return 0;
+}
@@ -0,0 +1,163 @@
+#ifndef EPOCH_RECLAIMER_HPP
+#define EPOCH_RECLAIMER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <CachePadded.hpp>
+#include <shardedcounter.h>
+
+//Epoch based reclamation for structures whose readers take no locks. A reader holds a Guard while
+//it follows pointers, which announces the global epoch in a slot of its own. Memory unlinked by a
+//writer is retired with the epoch of the moment, and freed once the global epoch is two ahead:
+//the epoch only advances when every active slot has caught up with it, so no reader that could
+//still see the memory is left.
+class EpochReclaimer
+{
+    public:
+        class Guard
+        {
+            public:
+                explicit Guard(EpochReclaimer& reclaimer);
+                ~Guard();
+            private:
+                std::atomic<uint64_t>& slot_;
+                Guard(const Guard& guard) = delete;
+        };
+
+        //Guards beyond slots concurrent ones wait for a slot to free up
+        explicit EpochReclaimer(size_t slots = 4 * std::max(16u, std::thread::hardware_concurrency()));
+
+        uint64_t epoch() const;
+        //Moves the global epoch forward if no active reader lags behind it
+        void tryAdvance();
+        bool safe(uint64_t retiredAt) const;
+
+    private:
+        //0 when free, otherwise (announced epoch << 1) | 1
+        std::unique_ptr<CachePadded<std::atomic<uint64_t>>[]> slots_;
+        size_t slotCount_;
+        CACHE_ALIGNED std::atomic<uint64_t> epoch_;
+
+        EpochReclaimer(const EpochReclaimer& reclaimer) = delete;
+        std::atomic<uint64_t>& enter();
+};
+
+//Memory waiting for its epoch to pass, owned by a single writer at a time (callers lock around it)
+class EpochRetireList
+{
+    public:
+        EpochRetireList() {}
+        //Frees everything, only valid once no reader can be active
+        ~EpochRetireList();
+
+        //Call after pointer is unlinked
+        template <class T>
+        void retire(const EpochReclaimer& reclaimer, T* pointer);
+        //Frees what no reader can reach anymore
+        void reclaim(EpochReclaimer& reclaimer);
+        size_t size() const;
+
+    private:
+        struct Retired
+        {
+            uint64_t epoch;
+            void* pointer;
+            void (*destroy)(void* pointer);
+        };
+        std::vector<Retired> retired_;
+
+        EpochRetireList(const EpochRetireList& list) = delete;
+};
+
+
+
+inline EpochReclaimer::Guard::Guard(EpochReclaimer& reclaimer):slot_(reclaimer.enter())
+{
+}
+
+inline EpochReclaimer::Guard::~Guard()
+{
+    slot_.store(0, std::memory_order_release);
+}
+
+inline EpochReclaimer::EpochReclaimer(size_t slots):slots_(new CachePadded<std::atomic<uint64_t>>[std::max<size_t>(slots, 1)]),
+    slotCount_(std::max<size_t>(slots, 1))
+{
+    for(size_t i = 0; i < slotCount_; ++i)
+        slots_[i]->store(0);
+    epoch_.store(0);
+}
+
+inline uint64_t EpochReclaimer::epoch() const
+{
+    return epoch_.load(std::memory_order_acquire);
+}
+
+inline void EpochReclaimer::tryAdvance()
+{
+    uint64_t epoch = epoch_.load();
+    for(size_t i = 0; i < slotCount_; ++i)
+    {
+        uint64_t slot = slots_[i]->load();
+        if((slot & 1) && (slot >> 1) != epoch)
+            return;
+    }
+    epoch_.compare_exchange_strong(epoch, epoch + 1);
+}
+
+inline bool EpochReclaimer::safe(uint64_t retiredAt) const
+{
+    return epoch() >= retiredAt + 2;
+}
+
+//Starts at the caller's own slot, so uncontended guards only touch their own cache line.
+//The announcement is seq_cst, which orders it before every pointer the reader loads afterwards.
+inline std::atomic<uint64_t>& EpochReclaimer::enter()
+{
+    size_t slot = ShardedCounter::threadIndex() % slotCount_;
+    for(size_t tries = 1; ; ++tries, slot = (slot + 1) % slotCount_)
+    {
+        uint64_t expected = 0;
+        if(slots_[slot]->compare_exchange_strong(expected, (epoch_.load() << 1) | 1))
+            return *slots_[slot];
+        if(tries % slotCount_ == 0)
+            std::this_thread::yield();
+    }
+}
+
+inline EpochRetireList::~EpochRetireList()
+{
+    for(auto& retired: retired_)
+        retired.destroy(retired.pointer);
+}
+
+//The fence orders the caller's unlink before the epoch is read: a reader announcing a later epoch
+//then cannot still find the memory, matching the seq_cst announcement in enter()
+template <class T>
+void EpochRetireList::retire(const EpochReclaimer& reclaimer, T* pointer)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    retired_.push_back({reclaimer.epoch(), pointer, [](void* pointer){ delete static_cast<T*>(pointer); }});
+}
+
+inline void EpochRetireList::reclaim(EpochReclaimer& reclaimer)
+{
+    reclaimer.tryAdvance();
+    auto kept = std::partition(retired_.begin(), retired_.end(), [&reclaimer](const Retired& retired){
+        return !reclaimer.safe(retired.epoch);
+    });
+    for(auto it = kept; it != retired_.end(); ++it)
+        it->destroy(it->pointer);
+    retired_.erase(kept, retired_.end());
+}
+
+inline size_t EpochRetireList::size() const
+{
+    return retired_.size();
+}
+
+#endif
@@ -0,0 +1,373 @@
+#ifndef STRIPED_HASH_MAP_HPP
+#define STRIPED_HASH_MAP_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <futex.h>
+#include <CachePadded.hpp>
+#include <EpochReclaimer.hpp>
+
+//Concurrent hash map with bucket chaining.
+//Writers lock one of a fixed set of Futex stripes, chosen by the hash alone, so a key keeps its
+//stripe across resizes. Readers take no lock: nodes are immutable once linked (assign() links a
+//fresh copy in place of the old node) and unlinked nodes are freed through EpochReclaimer.
+//
+//Growing is incremental. The writer that pushes a stripe past LOAD_FACTOR allocates a table twice as
+//large, and from then on every write first moves up to MIGRATE_CHUNK old buckets over. A moved
+//bucket is left holding FORWARD, and readers and writers that find it continue in the next table.
+//Bucket i of the old table splits into buckets i and i + size of the new one, both on i's stripe.
+template <class K, class V, class HASH = std::hash<K>>
+class StripedHashMap
+{
+    public:
+        explicit StripedHashMap(size_t buckets = 64, size_t stripes = 64);
+        ~StripedHashMap();
+
+        bool find(const K& key, V& value) const;
+        bool contains(const K& key) const;
+        //false and no change when key is already there
+        bool insert(const K& key, const V& value);
+        //Inserts or replaces, true when key was new
+        bool assign(const K& key, const V& value);
+        bool erase(const K& key);
+        //Sum of per-stripe counts, exact once writers stop
+        size_t size() const;
+        //Buckets of the newest table, resize in progress or not
+        size_t buckets() const;
+
+    private:
+        static const size_t LOAD_FACTOR = 2;
+        static const size_t MIGRATE_CHUNK = 8;
+        static const size_t RECLAIM_THRESHOLD = 64;
+
+        struct Node
+        {
+            Node(const K& key, const V& value, uint64_t hash, Node* next):key(key), value(value), hash(hash), next(next) {}
+            const K key;
+            const V value;
+            const uint64_t hash;
+            std::atomic<Node*> next;
+        };
+        struct Table
+        {
+            explicit Table(size_t size);
+            const size_t size;
+            std::unique_ptr<std::atomic<Node*>[]> buckets;
+            //Set once, when this table starts migrating into a larger one
+            std::atomic<Table*> next;
+            //Buckets handed out to migrating writers and buckets done
+            std::atomic<size_t> claimed;
+            std::atomic<size_t> migrated;
+        };
+        struct Stripe
+        {
+            Stripe():count(0) {}
+            Futex lock;
+            std::atomic<size_t> count;
+            EpochRetireList retired;
+        };
+
+        HASH hasher_;
+        size_t stripeCount_;
+        mutable EpochReclaimer epochs_;
+        std::unique_ptr<CachePadded<Stripe>[]> stripes_;
+        CACHE_ALIGNED std::atomic<Table*> table_;
+
+        StripedHashMap(const StripedHashMap& map) = delete;
+        static Node* forward();
+        static size_t powerOfTwo(size_t size);
+        uint64_t hash(const K& key) const;
+        const Node* lookup(const K& key, uint64_t hash) const;
+        //Runs operation(bucket, stripe) with the stripe of hash locked and bucket resolved past FORWARD
+        template <class OPERATION>
+        void write(uint64_t hash, OPERATION operation);
+        void help();
+        void migrate(Table* from, Table* to, size_t bucket);
+        void grow(Table* table, Stripe& stripe);
+        void retire(Stripe& stripe, Node* node);
+};
+
+
+
+template <class K, class V, class HASH>
+StripedHashMap<K, V, HASH>::Table::Table(size_t size):size(size), buckets(new std::atomic<Node*>[size]), next(nullptr),
+    claimed(0), migrated(0)
+{
+    for(size_t i = 0; i < size; ++i)
+        buckets[i].store(nullptr, std::memory_order_relaxed);
+}
+
+template <class K, class V, class HASH>
+StripedHashMap<K, V, HASH>::StripedHashMap(size_t buckets, size_t stripes):stripeCount_(powerOfTwo(stripes)),
+    stripes_(new CachePadded<Stripe>[stripeCount_])
+{
+    table_.store(new Table(std::max(powerOfTwo(buckets), stripeCount_)));
+}
+
+template <class K, class V, class HASH>
+StripedHashMap<K, V, HASH>::~StripedHashMap()
+{
+    for(Table* table = table_.load(); table != nullptr; )
+    {
+        for(size_t i = 0; i < table->size; ++i)
+            for(Node* node = table->buckets[i].load(); node != nullptr && node != forward(); )
+            {
+                Node* next = node->next.load();
+                delete node;
+                node = next;
+            }
+        Table* next = table->next.load();
+        delete table;
+        table = next;
+    }
+}
+
+template <class K, class V, class HASH>
+bool StripedHashMap<K, V, HASH>::find(const K& key, V& value) const
+{
+    EpochReclaimer::Guard guard(epochs_);
+    const Node* node = lookup(key, hash(key));
+    if(node == nullptr)
+        return false;
+    value = node->value;
+    return true;
+}
+
+template <class K, class V, class HASH>
+bool StripedHashMap<K, V, HASH>::contains(const K& key) const
+{
+    EpochReclaimer::Guard guard(epochs_);
+    return lookup(key, hash(key)) != nullptr;
+}
+
+template <class K, class V, class HASH>
+bool StripedHashMap<K, V, HASH>::insert(const K& key, const V& value)
+{
+    uint64_t keyHash = hash(key);
+    std::unique_ptr<Node> node(new Node(key, value, keyHash, nullptr));
+    bool inserted = false;
+    EpochReclaimer::Guard guard(epochs_);
+    help();
+    write(keyHash, [&](std::atomic<Node*>& bucket, Stripe& stripe){
+        Node* head = bucket.load(std::memory_order_relaxed);
+        for(Node* current = head; current != nullptr; current = current->next.load(std::memory_order_relaxed))
+            if(current->hash == keyHash && current->key == key)
+                return;
+        node->next.store(head, std::memory_order_relaxed);
+        bucket.store(node.release(), std::memory_order_release);
+        stripe.count.store(stripe.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        inserted = true;
+    });
+    return inserted;
+}
+
+template <class K, class V, class HASH>
+bool StripedHashMap<K, V, HASH>::assign(const K& key, const V& value)
+{
+    uint64_t keyHash = hash(key);
+    std::unique_ptr<Node> node(new Node(key, value, keyHash, nullptr));
+    bool inserted = false;
+    EpochReclaimer::Guard guard(epochs_);
+    help();
+    write(keyHash, [&](std::atomic<Node*>& bucket, Stripe& stripe){
+        std::atomic<Node*>* link = &bucket;
+        Node* current = bucket.load(std::memory_order_relaxed);
+        while(current != nullptr && !(current->hash == keyHash && current->key == key))
+        {
+            link = &current->next;
+            current = current->next.load(std::memory_order_relaxed);
+        }
+        if(current == nullptr)
+        {
+            node->next.store(bucket.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            bucket.store(node.release(), std::memory_order_release);
+            stripe.count.store(stripe.count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            inserted = true;
+            return;
+        }
+        node->next.store(current->next.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        link->store(node.release(), std::memory_order_release);
+        retire(stripe, current);
+    });
+    return inserted;
+}
+
+template <class K, class V, class HASH>
+bool StripedHashMap<K, V, HASH>::erase(const K& key)
+{
+    uint64_t keyHash = hash(key);
+    bool erased = false;
+    EpochReclaimer::Guard guard(epochs_);
+    help();
+    write(keyHash, [&](std::atomic<Node*>& bucket, Stripe& stripe){
+        std::atomic<Node*>* link = &bucket;
+        Node* current = bucket.load(std::memory_order_relaxed);
+        while(current != nullptr && !(current->hash == keyHash && current->key == key))
+        {
+            link = &current->next;
+            current = current->next.load(std::memory_order_relaxed);
+        }
+        if(current == nullptr)
+            return;
+        link->store(current->next.load(std::memory_order_relaxed), std::memory_order_release);
+        stripe.count.store(stripe.count.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+        retire(stripe, current);
+        erased = true;
+    });
+    return erased;
+}
+
+template <class K, class V, class HASH>
+size_t StripedHashMap<K, V, HASH>::size() const
+{
+    size_t size = 0;
+    for(size_t i = 0; i < stripeCount_; ++i)
+        size += stripes_[i]->count.load(std::memory_order_relaxed);
+    return size;
+}
+
+template <class K, class V, class HASH>
+size_t StripedHashMap<K, V, HASH>::buckets() const
+{
+    EpochReclaimer::Guard guard(epochs_);
+    Table* table = table_.load(std::memory_order_acquire);
+    for(Table* next = table->next.load(std::memory_order_acquire); next != nullptr; next = next->next.load(std::memory_order_acquire))
+        table = next;
+    return table->size;
+}
+
+//Address nothing else can have, marks a bucket that moved to the next table
+template <class K, class V, class HASH>
+typename StripedHashMap<K, V, HASH>::Node* StripedHashMap<K, V, HASH>::forward()
+{
+    static char marker;
+    return reinterpret_cast<Node*>(&marker);
+}
+
+template <class K, class V, class HASH>
+size_t StripedHashMap<K, V, HASH>::powerOfTwo(size_t size)
+{
+    size_t rounded = 1;
+    while(rounded < size)
+        rounded *= 2;
+    return rounded;
+}
+
+//std::hash of integers is the identity, mix it so the low bits picking bucket and stripe vary
+template <class K, class V, class HASH>
+uint64_t StripedHashMap<K, V, HASH>::hash(const K& key) const
+{
+    uint64_t hash = uint64_t(hasher_(key)) * 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 32);
+}
+
+template <class K, class V, class HASH>
+const typename StripedHashMap<K, V, HASH>::Node* StripedHashMap<K, V, HASH>::lookup(const K& key, uint64_t hash) const
+{
+    Table* table = table_.load(std::memory_order_acquire);
+    while(true)
+    {
+        Node* node = table->buckets[hash & (table->size - 1)].load(std::memory_order_acquire);
+        if(node == forward())
+        {
+            table = table->next.load(std::memory_order_acquire);
+            continue;
+        }
+        for(; node != nullptr; node = node->next.load(std::memory_order_acquire))
+            if(node->hash == hash && node->key == key)
+                return node;
+        return nullptr;
+    }
+}
+
+template <class K, class V, class HASH>
+template <class OPERATION>
+void StripedHashMap<K, V, HASH>::write(uint64_t hash, OPERATION operation)
+{
+    Stripe& stripe = *stripes_[hash & (stripeCount_ - 1)];
+    int self = stripe.lock.Hasher(std::this_thread::get_id());
+    stripe.lock.lock(self);
+    Table* table = table_.load(std::memory_order_acquire);
+    std::atomic<Node*>* bucket = &table->buckets[hash & (table->size - 1)];
+    while(bucket->load(std::memory_order_relaxed) == forward())
+    {
+        table = table->next.load(std::memory_order_acquire);
+        bucket = &table->buckets[hash & (table->size - 1)];
+    }
+    operation(*bucket, stripe);
+    grow(table, stripe);
+    if(stripe.retired.size() >= RECLAIM_THRESHOLD)
+        stripe.retired.reclaim(epochs_);
+    stripe.lock.unlock(self);
+}
+
+//Moves up to MIGRATE_CHUNK buckets of a table being resized, called with no stripe locked
+template <class K, class V, class HASH>
+void StripedHashMap<K, V, HASH>::help()
+{
+    Table* table = table_.load(std::memory_order_acquire);
+    Table* next = table->next.load(std::memory_order_acquire);
+    if(next == nullptr)
+        return;
+    for(size_t i = 0; i < MIGRATE_CHUNK; ++i)
+    {
+        size_t bucket = table->claimed.fetch_add(1, std::memory_order_relaxed);
+        if(bucket >= table->size)
+            return;
+        migrate(table, next, bucket);
+    }
+}
+
+//Readers may still be walking the old chain, so its nodes are copied and retired rather than relinked
+template <class K, class V, class HASH>
+void StripedHashMap<K, V, HASH>::migrate(Table* from, Table* to, size_t bucket)
+{
+    Stripe& stripe = *stripes_[bucket & (stripeCount_ - 1)];
+    int self = stripe.lock.Hasher(std::this_thread::get_id());
+    stripe.lock.lock(self);
+    Node* head = from->buckets[bucket].load(std::memory_order_relaxed);
+    for(Node* node = head; node != nullptr; node = node->next.load(std::memory_order_relaxed))
+    {
+        std::atomic<Node*>& target = to->buckets[node->hash & (to->size - 1)];
+        target.store(new Node(node->key, node->value, node->hash, target.load(std::memory_order_relaxed)),
+                     std::memory_order_relaxed);
+    }
+    from->buckets[bucket].store(forward(), std::memory_order_release);
+    for(Node* node = head; node != nullptr; )
+    {
+        Node* next = node->next.load(std::memory_order_relaxed);
+        retire(stripe, node);
+        node = next;
+    }
+    if(from->migrated.fetch_add(1, std::memory_order_acq_rel) + 1 == from->size)
+    {
+        table_.store(to, std::memory_order_release);
+        stripe.retired.retire(epochs_, from);
+    }
+    stripe.lock.unlock(self);
+}
+
+//Called with stripe locked after a write to table, starts a resize when the stripe got too full
+template <class K, class V, class HASH>
+void StripedHashMap<K, V, HASH>::grow(Table* table, Stripe& stripe)
+{
+    if(stripe.count.load(std::memory_order_relaxed) <= LOAD_FACTOR * (table->size / stripeCount_) ||
+       table->next.load(std::memory_order_relaxed) != nullptr)
+        return;
+    std::unique_ptr<Table> next(new Table(table->size * 2));
+    Table* expected = nullptr;
+    if(table->next.compare_exchange_strong(expected, next.get(), std::memory_order_acq_rel))
+        next.release();
+}
+
+template <class K, class V, class HASH>
+void StripedHashMap<K, V, HASH>::retire(Stripe& stripe, Node* node)
+{
+    stripe.retired.retire(epochs_, node);
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include "StripedHashMap.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <functional>
+#include <vector>
+#include <iostream>
+#include <memory>
+
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MODULE STRIPED_HASH_MAP_UNIT_TEST
+#include <boost/test/unit_test.hpp>
+
+//Every key in one bucket chain, resizes then only move the chain around
+struct CollidingHash
+{
+    size_t operator()(int) const
+    {
+        return 42;
+    }
+};
+
+template <class HASH>
+void TestSingleThread(int items)
+{
+    StripedHashMap<int, std::string, HASH> map(4, 4);
+    size_t buckets = map.buckets();
+    for(int i = 0; i < items; ++i)
+        BOOST_CHECK(map.insert(i, std::to_string(i)));
+    BOOST_CHECK(!map.insert(0, "again"));
+    BOOST_CHECK(map.size() == items);
+    BOOST_CHECK(map.buckets() > buckets);
+    std::string value;
+    for(int i = 0; i < items; ++i)
+        BOOST_CHECK(map.find(i, value) && value == std::to_string(i));
+    BOOST_CHECK(!map.find(items, value));
+    BOOST_CHECK(!map.assign(0, "zero"));
+    BOOST_CHECK(map.find(0, value) && value == "zero");
+    BOOST_CHECK(map.assign(items, "new"));
+    for(int i = 0; i <= items; i += 2)
+        BOOST_CHECK(map.erase(i));
+    BOOST_CHECK(!map.erase(0));
+    for(int i = 0; i <= items; ++i)
+        BOOST_CHECK(map.contains(i) == (i % 2 == 1));
+    BOOST_CHECK(map.size() == items / 2);
+}
+BOOST_AUTO_TEST_CASE(singleThread)
+{
+    std::cout << "singleThread" << std::endl;
+    TestSingleThread<std::hash<int>>(100000);
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(singleThreadCollisions)
+{
+    std::cout << "singleThreadCollisions" << std::endl;
+    TestSingleThread<CollidingHash>(2000);
+    std::cout << std::endl;
+}
+
+//Threads insert disjoint ranges into a map that starts tiny, so most inserts race a resize
+BOOST_AUTO_TEST_CASE(concurrentInsert)
+{
+    std::cout << "concurrentInsert" << std::endl;
+    const int nThreads = 8;
+    const int itemsPerThread = 50000;
+    StripedHashMap<int, int> map(4, 4);
+    std::vector<std::thread*> threads;
+    for(int t = 0; t < nThreads; ++t)
+        threads.push_back(new std::thread([&map, t, itemsPerThread](){
+            for(int i = t * itemsPerThread; i < (t + 1) * itemsPerThread; ++i)
+                map.insert(i, -i);
+        }));
+    for(auto thread: threads)
+    {
+        thread->join();
+        delete thread;
+    }
+    BOOST_CHECK(map.size() == nThreads * itemsPerThread);
+    int value;
+    for(int i = 0; i < nThreads * itemsPerThread; ++i)
+        BOOST_CHECK(map.find(i, value) && value == -i);
+    std::cout << "buckets: " << map.buckets() << std::endl;
+    std::cout << std::endl;
+}
+
+//Writers keep replacing, erasing and reinserting keys while readers check every value they see
+//still belongs to its key: a reader following a freed or half-built node would catch garbage
+BOOST_AUTO_TEST_CASE(concurrentMixed)
+{
+    std::cout << "concurrentMixed" << std::endl;
+    const int nWriters = 4;
+    const int nReaders = 4;
+    const int keys = 4096;
+    const int rounds = 30;
+    StripedHashMap<int, std::pair<int, int>> map(16, 16);
+    std::atomic<bool> done(false);
+    std::atomic<long long> bad(0);
+    std::atomic<long long> seen(0);
+    std::vector<std::thread*> readers, writers;
+    for(int r = 0; r < nReaders; ++r)
+        readers.push_back(new std::thread([&](){
+            std::pair<int, int> value;
+            long long found = 0;
+            for(int key = 0; !done.load(); key = (key + 1) % keys)
+                if(map.find(key, value))
+                {
+                    ++found;
+                    if(value.first != key || value.second % keys != key)
+                        bad.fetch_add(1);
+                }
+            seen.fetch_add(found);
+        }));
+    for(int w = 0; w < nWriters; ++w)
+        writers.push_back(new std::thread([&map, w, keys, rounds](){
+            for(int round = 0; round < rounds; ++round)
+                for(int key = w; key < keys; key += nWriters)
+                {
+                    map.assign(key, std::make_pair(key, key + round * keys));
+                    if(round % 3 == 1)
+                        map.erase(key);
+                }
+        }));
+    for(auto writer: writers)
+    {
+        writer->join();
+        delete writer;
+    }
+    done.store(true);
+    for(auto reader: readers)
+    {
+        reader->join();
+        delete reader;
+    }
+    BOOST_CHECK(bad.load() == 0);
+    BOOST_CHECK(map.size() == keys);
+    std::pair<int, int> value;
+    for(int key = 0; key < keys; ++key)
+        BOOST_CHECK(map.find(key, value) && value.second == key + (rounds - 1) * keys);
+    std::cout << "reads that found a key: " << seen.load() << std::endl;
+    std::cout << std::endl;
+}
+
+//Only one of the threads racing to insert the same key wins it
+BOOST_AUTO_TEST_CASE(insertRace)
+{
+    std::cout << "insertRace" << std::endl;
+    const int nThreads = 4;
+    const int keys = 20000;
+    StripedHashMap<int, int> map;
+    std::atomic<int> wins(0);
+    std::vector<std::thread*> threads;
+    for(int t = 0; t < nThreads; ++t)
+        threads.push_back(new std::thread([&map, &wins, t, keys](){
+            int won = 0;
+            for(int key = 0; key < keys; ++key)
+                if(map.insert(key, t))
+                    ++won;
+            wins.fetch_add(won);
+        }));
+    for(auto thread: threads)
+    {
+        thread->join();
+        delete thread;
+    }
+    BOOST_CHECK(wins.load() == keys);
+    BOOST_CHECK(map.size() == keys);
+    std::cout << std::endl;
+}
@@ -0,0 +1,87 @@
+#include "CSyncContainer.hpp"
+#include "BenchmarkReport.hpp"
+#include "CpuTopology.hpp"
+#include <algorithm>
+#include <thread>
+#include <deque>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+const int SAMPLES = 20000;
+
+int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//One producer stamps items every gap nanoseconds, one consumer measures push-to-pop latency
+template <class CONTAINER>
+std::vector<int64_t> run(int64_t gap, std::chrono::nanoseconds maxSpin)
+{
+    CSyncContainer<CONTAINER> queue;
+    queue.setMaxSpin(maxSpin);
+    std::vector<int64_t> latencies;
+    latencies.reserve(SAMPLES);
+    auto consumer = new std::thread([&queue, &latencies](){
+        int64_t stamp;
+        while(queue.popOrSleep(stamp))
+            latencies.push_back(now() - stamp);
+    });
+    auto producer = new std::thread([&queue, gap](){
+        int64_t next = now();
+        for(int i = 0; i < SAMPLES; ++i)
+        {
+            next += gap;
+            while(now() < next);
+            queue.push(now());
+        }
+    });
+    //Separate physical cores when there are two, the handoff then crosses caches as it would in a pool
+    auto placement = CpuTopology::instance().placement(CpuTopology::ONE_PER_CORE, 2);
+    CpuTopology::pin(*consumer, placement[0]);
+    CpuTopology::pin(*producer, placement[1]);
+    producer->join();
+    delete producer;
+    queue.terminate();
+    consumer->join();
+    delete consumer;
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+int64_t percentile(const std::vector<int64_t>& sorted, double p)
+{
+    if(sorted.empty())
+        return 0;
+    return sorted[std::min(sorted.size() - 1, size_t(p * sorted.size()))];
+}
+
+template <class CONTAINER>
+void report(const char* name, int64_t gap)
+{
+    auto sleeping = run<CONTAINER>(gap, std::chrono::nanoseconds(0));
+    auto spinning = run<CONTAINER>(gap, std::chrono::microseconds(50));
+    std::cout << name << "\t" << gap
+              << "\t" << percentile(sleeping, 0.5) << "\t" << percentile(sleeping, 0.99)
+              << "\t" << percentile(spinning, 0.5) << "\t" << percentile(spinning, 0.99) << std::endl;
+    std::string prefix = std::string("synccontainer/handoff/") + name + "/gap=" + std::to_string(gap);
+    BenchmarkReport::record(prefix + "/sleep/p50", percentile(sleeping, 0.5), "ns", BenchmarkReport::LOWER);
+    BenchmarkReport::record(prefix + "/sleep/p99", percentile(sleeping, 0.99), "ns", BenchmarkReport::LOWER);
+    BenchmarkReport::record(prefix + "/spin/p50", percentile(spinning, 0.5), "ns", BenchmarkReport::LOWER);
+    BenchmarkReport::record(prefix + "/spin/p99", percentile(spinning, 0.99), "ns", BenchmarkReport::LOWER);
+}
+
+int main()
+{
+    std::cout << "container\tgap\tsleep p50\tsleep p99\tspin p50\tspin p99\t[ns]" << std::endl;
+    for(int64_t gap: {1000, 10000, 100000})
+    {
+        report<std::deque<int64_t>>("std::deque", gap);
+        report<std::queue<int64_t>>("std::queue", gap);
+    }
+    return 0;
+}
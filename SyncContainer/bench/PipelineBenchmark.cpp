@@ -0,0 +1,63 @@
+#include "CPipeline.hpp"
+#include "BenchmarkReport.hpp"
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+const int ITEMS = 200000;
+
+int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Busy work standing in for a stage that costs cost nanoseconds per item
+int work(int value, int64_t cost)
+{
+    int64_t end = now() + cost;
+    while(now() < end)
+        value = value * 31 + 7;
+    return value;
+}
+
+//Three stages where the middle one is four times as expensive, the stats should single it out
+void run(unsigned int middleParallelism, size_t batch)
+{
+    CPipeline<int> input(64);
+    std::atomic<long long> sink(0);
+    auto last = input.stage("light", [](int value){ return work(value, 500); }, 1, 64, batch)
+                     .stage("heavy", [](int value){ return work(value, 2000); }, middleParallelism, 64, batch)
+                     .stage("sink", [&sink](int value){ sink += value; }, 1);
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < ITEMS; i += 100)
+    {
+        std::vector<int> items;
+        for(int j = i; j < i + 100; ++j)
+            items.push_back(j);
+        input.push(std::move(items));
+    }
+    input.close();
+    last.wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "heavy x" << middleParallelism << ", batch " << batch << ": "
+              << ITEMS / elapsed.count() << " items/s" << std::endl;
+    BenchmarkReport::record("synccontainer/pipeline/heavy=" + std::to_string(middleParallelism) + "/batch=" +
+                            std::to_string(batch), ITEMS / elapsed.count(), "items/s");
+    std::cout << "stage\tthreads\titems/s\tutilization\tservice[ns]\tqueue latency[ns]\tmax latency[ns]\tblocked[ms]" << std::endl;
+    for(auto& stage: last.stats())
+        std::cout << stage.name << "\t" << stage.parallelism << "\t" << stage.throughput()
+                  << "\t" << stage.utilization() << "\t" << stage.serviceTime().count()
+                  << "\t" << stage.meanQueueLatency().count() << "\t" << stage.maxQueueLatency.count()
+                  << "\t" << std::chrono::duration_cast<std::chrono::milliseconds>(stage.blocked).count() << std::endl;
+    std::cout << std::endl;
+}
+
+int main()
+{
+    run(1, 1);
+    run(1, 64);
+    run(std::max(1u, std::thread::hardware_concurrency() - 1), 64);
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "CSyncContainer.hpp"
+#include "CSyncContainerHeap.hpp"
+#include "BenchmarkReport.hpp"
+#include "CpuTopology.hpp"
+#include <algorithm>
+#include <thread>
+#include <queue>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <string>
+
+const int ITEMS = 2000000;
+
+//One thread per physical core while there are enough, then compact wrap-around
+std::vector<int> pinning(size_t numberOfThreads)
+{
+    const CpuTopology& topology = CpuTopology::instance();
+    return topology.placement(numberOfThreads <= topology.cores() ? CpuTopology::ONE_PER_CORE : CpuTopology::COMPACT,
+                              numberOfThreads);
+}
+
+//Half of the threads push ITEMS / producers scrambled priorities each, the other half pop until termination
+template <class QUEUE>
+double run(QUEUE& queue, unsigned int numberOfThreads)
+{
+    unsigned int producers = std::max(1u, numberOfThreads / 2);
+    unsigned int consumers = std::max(1u, numberOfThreads - producers);
+    std::vector<std::thread*> producerThreads;
+    std::vector<std::thread*> consumerThreads;
+    auto placement = pinning(producers + consumers);
+    std::chrono::time_point<std::chrono::steady_clock> start, end;
+    start = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < consumers; ++i)
+    {
+        consumerThreads.push_back(new std::thread([&queue](){
+            int item;
+            while(queue.popOrSleep(item));
+        }));
+        CpuTopology::pin(*consumerThreads.back(), placement[i]);
+    }
+    for(unsigned int i = 0; i < producers; ++i)
+    {
+        producerThreads.push_back(new std::thread([&queue, producers](){
+            //Ascending priorities would sift every insert up to the root
+            for(unsigned int j = 0; j < ITEMS / producers; ++j)
+                queue.push(int(j * 2654435761u >> 1));
+        }));
+        CpuTopology::pin(*producerThreads.back(), placement[consumers + i]);
+    }
+    for(auto th: producerThreads)
+    {
+        th->join();
+        delete th;
+    }
+    queue.terminate();
+    for(auto th: consumerThreads)
+    {
+        th->join();
+        delete th;
+    }
+    end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    return ITEMS / elapsed.count();
+}
+
+int main()
+{
+    unsigned int maxThreads = std::max(2u, 2 * std::thread::hardware_concurrency());
+    std::cout << "threads\tlocking (std::priority_queue)\tfine-grained (CConcurrentHeap)\t[items/s]" << std::endl;
+    for(unsigned int threads = 2; threads <= maxThreads; threads *= 2)
+    {
+        CSyncContainer<std::priority_queue<int>> locking;
+        CSyncContainer<std::priority_queue<int>, CFineGrainedBackend> fineGrained;
+        double results[] = {run(locking, threads), run(fineGrained, threads)};
+        const char* names[] = {"locking", "finegrained"};
+        std::cout << threads;
+        for(int i = 0; i < 2; ++i)
+        {
+            std::cout << "\t" << results[i];
+            BenchmarkReport::record(std::string("synccontainer/priority/") + names[i] + "/threads=" +
+                                    std::to_string(threads), results[i], "items/s");
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
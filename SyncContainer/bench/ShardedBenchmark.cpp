@@ -0,0 +1,92 @@
+#include "CSyncContainer.hpp"
+#include "CShardedSyncContainer.hpp"
+#include "CSyncContainerLockFree.hpp"
+#include "BenchmarkReport.hpp"
+#include "CpuTopology.hpp"
+#include <algorithm>
+#include <thread>
+#include <functional>
+#include <deque>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <string>
+
+const int ITEMS = 2000000;
+
+//One thread per physical core while there are enough, then compact wrap-around
+std::vector<int> pinning(size_t numberOfThreads)
+{
+    const CpuTopology& topology = CpuTopology::instance();
+    return topology.placement(numberOfThreads <= topology.cores() ? CpuTopology::ONE_PER_CORE : CpuTopology::COMPACT,
+                              numberOfThreads);
+}
+
+//Half of the threads produce ITEMS / producers items each, the other half consume until termination
+template <class QUEUE>
+double run(QUEUE& queue, unsigned int numberOfThreads)
+{
+    unsigned int producers = std::max(1u, numberOfThreads / 2);
+    unsigned int consumers = std::max(1u, numberOfThreads - producers);
+    std::vector<std::thread*> producerThreads;
+    std::vector<std::thread*> consumerThreads;
+    auto placement = pinning(producers + consumers);
+    std::chrono::time_point<std::chrono::steady_clock> start, end;
+    start = std::chrono::steady_clock::now();
+    for(unsigned int i = 0; i < consumers; ++i)
+    {
+        consumerThreads.push_back(new std::thread([&queue](){
+            int item;
+            while(queue.popOrSleep(item));
+        }));
+        CpuTopology::pin(*consumerThreads.back(), placement[i]);
+    }
+    for(unsigned int i = 0; i < producers; ++i)
+    {
+        producerThreads.push_back(new std::thread([&queue, producers](){
+            for(int j = 0; j < ITEMS / producers; ++j)
+                queue.push(j);
+        }));
+        CpuTopology::pin(*producerThreads.back(), placement[consumers + i]);
+    }
+    for(auto th: producerThreads)
+    {
+        th->join();
+        delete th;
+    }
+    queue.terminate();
+    for(auto th: consumerThreads)
+    {
+        th->join();
+        delete th;
+    }
+    end = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    return ITEMS / elapsed.count();
+}
+
+int main()
+{
+    unsigned int maxThreads = std::max(2u, 2 * std::thread::hardware_concurrency());
+    const char* layout = sizeof(CachePadded<char>) == 1 ? "unpadded" : "padded";
+    std::cout << "layout: " << layout << std::endl;
+    std::cout << "threads\tsingle lock (std::deque)\ttwo-lock (std::queue)\tsharded (std::queue)\tlock-free (std::queue)\t[items/s]" << std::endl;
+    for(unsigned int threads = 2; threads <= maxThreads; threads *= 2)
+    {
+        CSyncContainer<std::deque<int>> single;
+        CSyncContainer<std::queue<int>> twoLock;
+        CShardedSyncContainer<std::queue<int>> sharded;
+        CSyncContainer<std::queue<int>, CLockFreeBackend> lockFree;
+        double results[] = {run(single, threads), run(twoLock, threads), run(sharded, threads), run(lockFree, threads)};
+        const char* names[] = {"single", "twolock", "sharded", "lockfree"};
+        std::cout << threads;
+        for(int i = 0; i < 4; ++i)
+        {
+            std::cout << "\t" << results[i];
+            BenchmarkReport::record(std::string("synccontainer/throughput/") + layout + "/" + names[i] + "/threads=" +
+                                    std::to_string(threads), results[i], "items/s");
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "CSharedSyncContainer.hpp"
+#include "BenchmarkReport.hpp"
+#include "CpuTopology.hpp"
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+const int MESSAGES = 1000000;
+//Consumer (parent) and producer (child) on separate physical cores when there are two
+std::vector<int> placement;
+
+struct Message
+{
+    int64_t sequence;
+    char payload[56];
+};
+
+//Producer process writes MESSAGES fixed size messages into a socketpair, the parent reads them
+double runSocket()
+{
+    int sockets[2];
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+        return 0;
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        CpuTopology::pinCurrentThread(placement[1]);
+        close(sockets[0]);
+        Message message = {};
+        for(int i = 0; i < MESSAGES; ++i)
+        {
+            message.sequence = i;
+            for(size_t sent = 0; sent < sizeof(message);)
+                sent += write(sockets[1], reinterpret_cast<char*>(&message) + sent, sizeof(message) - sent);
+        }
+        _exit(0);
+    }
+    close(sockets[1]);
+    Message message;
+    for(int i = 0; i < MESSAGES; ++i)
+        for(size_t received = 0; received < sizeof(message);)
+        {
+            ssize_t count = read(sockets[0], reinterpret_cast<char*>(&message) + received, sizeof(message) - received);
+            if(count <= 0)
+                return 0;
+            received += count;
+        }
+    waitpid(pid, nullptr, 0);
+    close(sockets[0]);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//Same handoff through the shared ring, the producer fills slots in place
+double runShared(const std::string& name)
+{
+    CSharedSyncContainer<Message>::unlink(name);
+    CSharedSyncContainer<Message> queue(name, 1024);
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        CpuTopology::pinCurrentThread(placement[1]);
+        CSharedSyncContainer<Message> attached(name, 1024);
+        for(int i = 0; i < MESSAGES; ++i)
+        {
+            Message* message = attached.beginPushOrSleep();
+            message->sequence = i;
+            attached.commitPush(message);
+        }
+        _exit(0);
+    }
+    for(int i = 0; i < MESSAGES; ++i)
+        queue.endPop(queue.beginPopOrSleep());
+    waitpid(pid, nullptr, 0);
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    CSharedSyncContainer<Message>::unlink(name);
+    return elapsed;
+}
+
+int main()
+{
+    std::string name = "/SharedMemoryBenchmark." + std::to_string(getpid());
+    placement = CpuTopology::instance().placement(CpuTopology::ONE_PER_CORE, 2);
+    CpuTopology::pinCurrentThread(placement[0]);
+    std::cout << MESSAGES << " messages of " << sizeof(Message) << " bytes between two processes" << std::endl;
+    std::cout << "transport\tseconds\tmessages/s" << std::endl;
+    double socket = runSocket();
+    std::cout << "socketpair\t" << socket << "\t" << MESSAGES / socket << std::endl;
+    BenchmarkReport::record("synccontainer/ipc/socketpair", MESSAGES / socket, "messages/s");
+    double shared = runShared(name);
+    std::cout << "shared ring\t" << shared << "\t" << MESSAGES / shared << std::endl;
+    BenchmarkReport::record("synccontainer/ipc/sharedring", MESSAGES / shared, "messages/s");
+    return 0;
+}
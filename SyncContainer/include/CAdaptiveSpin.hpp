@@ -0,0 +1,125 @@
+#ifndef C_ADAPTIVE_SPIN
+#define C_ADAPTIVE_SPIN
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+//Spin-before-sleep policy for consumers.
+//Producers report every arrival, the spin budget is twice the moving average of the
+//inter-arrival time, and no spinning at all when items come in slower than maxSpin
+//or when there is a single CPU and the producer cannot run while we spin.
+//Only a random 1 in SAMPLE arrivals reads the clock and touches the shared line, the gap between
+//two samples then spans SAMPLE arrivals on average, whichever producers made them.
+class CAdaptiveSpin
+{
+    public:
+        explicit CAdaptiveSpin(std::chrono::nanoseconds maxSpin = std::chrono::microseconds(50));
+
+        void recordArrival();
+        //Polls ready() until it returns true or the budget is spent, returns the last ready() result
+        template <class PREDICATE>
+        bool spinUntil(PREDICATE ready) const;
+        //0 disables spinning, ignored on uniprocessors
+        void setMaxSpin(std::chrono::nanoseconds maxSpin);
+        std::chrono::nanoseconds budget() const;
+
+    private:
+        static const int SAMPLE = 16;
+
+        std::atomic<int64_t> lastArrival_;
+        std::atomic<int64_t> interArrival_;
+        std::atomic<int64_t> maxSpin_;
+
+        static bool sampled();
+        static int64_t now();
+        static void pause();
+};
+
+
+
+inline CAdaptiveSpin::CAdaptiveSpin(std::chrono::nanoseconds maxSpin)
+{
+    lastArrival_.store(0);
+    interArrival_.store(maxSpin.count() + 1);
+    setMaxSpin(maxSpin);
+}
+
+inline void CAdaptiveSpin::recordArrival()
+{
+    if(maxSpin_.load(std::memory_order_relaxed) == 0 || !sampled())
+        return;
+    int64_t arrival = now();
+    int64_t last = lastArrival_.exchange(arrival, std::memory_order_relaxed);
+    if(last == 0 || arrival < last)
+        return;
+    //Exponential moving average with weight 1/8, concurrent updates may lose a sample
+    int64_t average = interArrival_.load(std::memory_order_relaxed);
+    interArrival_.store(average + ((arrival - last) / SAMPLE - average) / 8, std::memory_order_relaxed);
+}
+
+template <class PREDICATE>
+bool CAdaptiveSpin::spinUntil(PREDICATE ready) const
+{
+    int64_t budget = this->budget().count();
+    if(budget == 0)
+        return ready();
+    int64_t deadline = now() + budget;
+    for(unsigned int i = 1; ; ++i)
+    {
+        if(ready())
+            return true;
+        pause();
+        if(i % 64 == 0 && now() >= deadline)
+            return ready();
+    }
+}
+
+inline void CAdaptiveSpin::setMaxSpin(std::chrono::nanoseconds maxSpin)
+{
+    static const bool multiprocessor = std::thread::hardware_concurrency() > 1;
+    maxSpin_.store(multiprocessor ? maxSpin.count() : 0, std::memory_order_relaxed);
+}
+
+inline std::chrono::nanoseconds CAdaptiveSpin::budget() const
+{
+    int64_t maxSpin = maxSpin_.load(std::memory_order_relaxed);
+    int64_t average = interArrival_.load(std::memory_order_relaxed);
+    if(average > maxSpin)
+        return std::chrono::nanoseconds(0);
+    return std::chrono::nanoseconds(std::min(2 * average, maxSpin));
+}
+
+//Per-thread xorshift rather than a counter: a thread alternating between containers would
+//otherwise always sample the same one
+inline bool CAdaptiveSpin::sampled()
+{
+    //Constant initialized, so no thread_local guard on the push path
+    static thread_local uint32_t state = 0;
+    if(state == 0)
+        state = uint32_t(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (state & (SAMPLE - 1)) == 0;
+}
+
+inline int64_t CAdaptiveSpin::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void CAdaptiveSpin::pause()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    std::this_thread::yield();
+#endif
+}
+
+#endif
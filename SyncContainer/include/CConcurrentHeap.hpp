@@ -0,0 +1,236 @@
+#ifndef C_CONCURRENT_HEAP
+#define C_CONCURRENT_HEAP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <CachePadded.hpp>
+
+//Concurrent binary heap with a lock per slot (Hunt, Michael, Parthasarathy, Scott, 1996).
+//The heap lock only guards the element count, inserts sift up and deletes sift down holding
+//at most two slot locks, always parent before child. Inserts fill the last level in bit-reversed
+//order so consecutive operations walk disjoint paths. Slots are stored one segment per level,
+//a segment never moves, so the heap grows without a global reallocation.
+//Same order as std::priority_queue: Pop returns the largest element according to COMPARE.
+//T has to be default constructible, empty slots hold a default constructed value.
+template <class T, class COMPARE = std::less<T>>
+class CConcurrentHeap
+{
+    public:
+        explicit CConcurrentHeap(const COMPARE& compare = COMPARE());
+        ~CConcurrentHeap();
+        void Push(T item);
+        bool Pop(T& item);
+    private:
+        //A slot's tag is EMPTY, AVAILABLE, or the id of the insert still sifting its item up
+        static const uint64_t EMPTY = 0;
+        static const uint64_t AVAILABLE = 1;
+        static const int MAX_LEVELS = 48;
+
+        struct Slot
+        {
+            Slot():tag(EMPTY) {}
+            std::mutex lock;
+            uint64_t tag;
+            T item;
+        };
+
+        std::mutex heapLock_;
+        size_t size_;
+        //Read-mostly, kept off the heap lock's line
+        CACHE_ALIGNED std::atomic<Slot*> levels_[MAX_LEVELS];
+        COMPARE compare_;
+        CACHE_ALIGNED std::atomic<uint64_t> nextTag_;
+
+        CConcurrentHeap(const CConcurrentHeap& heap) = delete;
+
+        static int level(size_t index);
+        //Index of the count-th element, bit-reversed within its level
+        static size_t position(size_t count);
+        Slot& slot(size_t index) const;
+        bool allocated(size_t index) const;
+        static void swap(Slot& first, Slot& second);
+};
+
+
+
+template <class T, class COMPARE>
+CConcurrentHeap<T, COMPARE>::CConcurrentHeap(const COMPARE& compare):size_(0), compare_(compare)
+{
+    for(int i = 0; i < MAX_LEVELS; ++i)
+        levels_[i].store(nullptr);
+    nextTag_.store(AVAILABLE + 1);
+}
+
+template <class T, class COMPARE>
+CConcurrentHeap<T, COMPARE>::~CConcurrentHeap()
+{
+    for(int i = 0; i < MAX_LEVELS; ++i)
+        delete[] levels_[i].load();
+}
+
+template <class T, class COMPARE>
+void CConcurrentHeap<T, COMPARE>::Push(T item)
+{
+    uint64_t tag = nextTag_.fetch_add(1, std::memory_order_relaxed);
+    std::unique_lock<std::mutex> heapLock(heapLock_);
+    size_t i = position(++size_);
+    int depth = level(i);
+    if(levels_[depth].load(std::memory_order_relaxed) == nullptr)
+        levels_[depth].store(new Slot[size_t(1) << depth], std::memory_order_release);
+    Slot& bottom = slot(i);
+    bottom.lock.lock();
+    heapLock.unlock();
+    bottom.item = std::move(item);
+    bottom.tag = tag;
+    bottom.lock.unlock();
+
+    while(i > 1)
+    {
+        Slot& parent = slot(i / 2);
+        Slot& child = slot(i);
+        parent.lock.lock();
+        child.lock.lock();
+        bool progress = true;
+        if(parent.tag == AVAILABLE && child.tag == tag)
+        {
+            if(compare_(parent.item, child.item))
+            {
+                swap(parent, child);
+                i /= 2;
+            }
+            else
+            {
+                child.tag = AVAILABLE;
+                i = 0;
+            }
+        }
+        else if(parent.tag == EMPTY)
+            i = 0;
+        else if(child.tag != tag)
+            i /= 2;     //A delete moved our item up while it sifted down
+        else
+            progress = false;   //Parent belongs to another insert that has not settled yet
+        child.lock.unlock();
+        parent.lock.unlock();
+        if(!progress)
+            std::this_thread::yield();
+    }
+    if(i == 1)
+    {
+        Slot& root = slot(1);
+        std::lock_guard<std::mutex> lock(root.lock);
+        if(root.tag == tag)
+            root.tag = AVAILABLE;
+    }
+}
+
+template <class T, class COMPARE>
+bool CConcurrentHeap<T, COMPARE>::Pop(T& item)
+{
+    std::unique_lock<std::mutex> heapLock(heapLock_);
+    if(size_ == 0)
+        return false;
+    Slot& bottom = slot(position(size_--));
+    bottom.lock.lock();
+    heapLock.unlock();
+    T last = std::move(bottom.item);
+    bottom.tag = EMPTY;
+    bottom.lock.unlock();
+
+    Slot& root = slot(1);
+    root.lock.lock();
+    //The bottom was the root itself
+    if(root.tag == EMPTY)
+    {
+        root.lock.unlock();
+        item = std::move(last);
+        return true;
+    }
+    item = std::move(root.item);
+    root.item = std::move(last);
+    root.tag = AVAILABLE;
+
+    size_t i = 1;
+    while(allocated(2 * i))
+    {
+        Slot& left = slot(2 * i);
+        Slot& right = slot(2 * i + 1);
+        left.lock.lock();
+        right.lock.lock();
+        //The last level fills left children first, so an empty left child means no children
+        if(left.tag == EMPTY)
+        {
+            right.lock.unlock();
+            left.lock.unlock();
+            break;
+        }
+        size_t child;
+        if(right.tag == EMPTY || compare_(right.item, left.item))
+        {
+            right.lock.unlock();
+            child = 2 * i;
+        }
+        else
+        {
+            left.lock.unlock();
+            child = 2 * i + 1;
+        }
+        if(compare_(slot(i).item, slot(child).item))
+        {
+            swap(slot(i), slot(child));
+            slot(i).lock.unlock();
+            i = child;
+        }
+        else
+        {
+            slot(child).lock.unlock();
+            break;
+        }
+    }
+    slot(i).lock.unlock();
+    return true;
+}
+
+template <class T, class COMPARE>
+int CConcurrentHeap<T, COMPARE>::level(size_t index)
+{
+    return 63 - __builtin_clzll(index);
+}
+
+template <class T, class COMPARE>
+size_t CConcurrentHeap<T, COMPARE>::position(size_t count)
+{
+    int depth = level(count);
+    size_t offset = count - (size_t(1) << depth);
+    size_t reversed = 0;
+    for(int bit = 0; bit < depth; ++bit)
+        reversed |= ((offset >> bit) & 1) << (depth - 1 - bit);
+    return (size_t(1) << depth) | reversed;
+}
+
+template <class T, class COMPARE>
+typename CConcurrentHeap<T, COMPARE>::Slot& CConcurrentHeap<T, COMPARE>::slot(size_t index) const
+{
+    int depth = level(index);
+    return levels_[depth].load(std::memory_order_acquire)[index - (size_t(1) << depth)];
+}
+
+template <class T, class COMPARE>
+bool CConcurrentHeap<T, COMPARE>::allocated(size_t index) const
+{
+    int depth = level(index);
+    return depth < MAX_LEVELS && levels_[depth].load(std::memory_order_acquire) != nullptr;
+}
+
+template <class T, class COMPARE>
+void CConcurrentHeap<T, COMPARE>::swap(Slot& first, Slot& second)
+{
+    std::swap(first.item, second.item);
+    std::swap(first.tag, second.tag);
+}
+
+#endif
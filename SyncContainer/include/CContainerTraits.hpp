@@ -0,0 +1,86 @@
+#ifndef C_CONTAINER_TRAITS
+#define C_CONTAINER_TRAITS
+
+#include <algorithm>
+#include <queue>
+#include <stack>
+#include <utility>
+
+//How CSyncContainer puts an element into CONTAINER and takes the next one out.
+//The primary template serves sequence containers (std::vector, std::deque, std::list) as LIFO;
+//other containers get a specialization, user containers can add their own the same way.
+template <class CONTAINER, class Enable = void>
+struct CContainerTraits
+{
+    typedef typename CONTAINER::value_type value_type;
+
+    template <class... Args>
+    static void emplace(CONTAINER& container, Args&&... args)
+    {
+        container.emplace_back(std::forward<Args>(args)...);
+    }
+    static void pop(CONTAINER& container, value_type& item)
+    {
+        item = std::move(container.back());
+        container.pop_back();
+    }
+};
+
+template <class T, class SEQUENCE>
+struct CContainerTraits<std::queue<T, SEQUENCE>>
+{
+    template <class... Args>
+    static void emplace(std::queue<T, SEQUENCE>& container, Args&&... args)
+    {
+        container.emplace(std::forward<Args>(args)...);
+    }
+    static void pop(std::queue<T, SEQUENCE>& container, T& item)
+    {
+        item = std::move(container.front());
+        container.pop();
+    }
+};
+
+template <class T, class SEQUENCE>
+struct CContainerTraits<std::stack<T, SEQUENCE>>
+{
+    template <class... Args>
+    static void emplace(std::stack<T, SEQUENCE>& container, Args&&... args)
+    {
+        container.emplace(std::forward<Args>(args)...);
+    }
+    static void pop(std::stack<T, SEQUENCE>& container, T& item)
+    {
+        item = std::move(container.top());
+        container.pop();
+    }
+};
+
+template <class T, class SEQUENCE, class COMPARE>
+struct CContainerTraits<std::priority_queue<T, SEQUENCE, COMPARE>>
+{
+    template <class... Args>
+    static void emplace(std::priority_queue<T, SEQUENCE, COMPARE>& container, Args&&... args)
+    {
+        container.emplace(std::forward<Args>(args)...);
+    }
+    //top() is const, so the item is moved out of the protected sequence instead: pop_heap puts it
+    //last and the heap never compares it again
+    static void pop(std::priority_queue<T, SEQUENCE, COMPARE>& container, T& item)
+    {
+        SEQUENCE& heap = container.*(&Access::c);
+        std::pop_heap(heap.begin(), heap.end(), container.*(&Access::comp));
+        item = std::move(heap.back());
+        heap.pop_back();
+    }
+
+private:
+    //Names the protected members c and comp, a pointer to member then reaches them in any priority_queue
+    struct Access: std::priority_queue<T, SEQUENCE, COMPARE>
+    {
+        using std::priority_queue<T, SEQUENCE, COMPARE>::c;
+        using std::priority_queue<T, SEQUENCE, COMPARE>::comp;
+    };
+};
+
+#endif
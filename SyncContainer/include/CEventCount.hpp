@@ -0,0 +1,121 @@
+#ifndef C_EVENT_COUNT
+#define C_EVENT_COUNT
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+//Eventcount: lets lock-free structures block without putting a mutex on the fast path.
+//A waiter announces itself with prepareWait(), re-checks its condition and only then sleeps
+//in wait(key); a notifier that finds no announced waiters returns after a single load.
+//state_ keeps the epoch in the upper 32 bits and the number of announced waiters in the lower 32.
+class CEventCount
+{
+    public:
+        typedef uint32_t Key;
+
+        CEventCount();
+
+        Key prepareWait();
+        //Withdraws the announcement when the re-check succeeded
+        void cancelWait();
+        //Sleeps until the epoch moves past key, returns immediately if it already has
+        void wait(Key key);
+        //Returns false on timeout, the announcement is withdrawn either way
+        template <class Clock, class Duration>
+        bool waitUntil(Key key, const std::chrono::time_point<Clock, Duration>& deadline);
+        //Callers must publish their change (push/pop) before notifying
+        void notify();
+        void notifyAll();
+
+    private:
+        static const uint64_t WAITER = 1;
+        static const uint64_t EPOCH = uint64_t(1) << 32;
+        static const uint64_t WAITER_MASK = EPOCH - 1;
+
+        std::atomic<uint64_t> state_;
+        std::mutex lock_;
+        std::condition_variable flag_;
+
+        bool advanced(Key key) const;
+        void advance(bool all);
+};
+
+
+
+inline CEventCount::CEventCount()
+{
+    state_.store(0);
+}
+
+inline CEventCount::Key CEventCount::prepareWait()
+{
+    //seq_cst pairs with the fence in notify: either the notifier sees the waiter or the waiter's re-check sees the change
+    return Key(state_.fetch_add(WAITER, std::memory_order_seq_cst) >> 32);
+}
+
+inline void CEventCount::cancelWait()
+{
+    state_.fetch_sub(WAITER, std::memory_order_relaxed);
+}
+
+inline void CEventCount::wait(Key key)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    while(!advanced(key))
+        flag_.wait(lock);
+    lock.unlock();
+    state_.fetch_sub(WAITER, std::memory_order_relaxed);
+}
+
+template <class Clock, class Duration>
+bool CEventCount::waitUntil(Key key, const std::chrono::time_point<Clock, Duration>& deadline)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    bool woken = true;
+    while(!advanced(key))
+    {
+        if(flag_.wait_until(lock, deadline) == std::cv_status::timeout)
+        {
+            woken = advanced(key);
+            break;
+        }
+    }
+    lock.unlock();
+    state_.fetch_sub(WAITER, std::memory_order_relaxed);
+    return woken;
+}
+
+inline void CEventCount::notify()
+{
+    advance(false);
+}
+
+inline void CEventCount::notifyAll()
+{
+    advance(true);
+}
+
+inline bool CEventCount::advanced(Key key) const
+{
+    return Key(state_.load(std::memory_order_acquire) >> 32) != key;
+}
+
+inline void CEventCount::advance(bool all)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if((state_.load(std::memory_order_relaxed) & WAITER_MASK) == 0)
+        return;
+    state_.fetch_add(EPOCH, std::memory_order_release);
+    //Taking the lock orders the epoch change before a waiter that already checked it goes to sleep
+    std::unique_lock<std::mutex> lock(lock_);
+    lock.unlock();
+    if(all)
+        flag_.notify_all();
+    else
+        flag_.notify_one();
+}
+
+#endif
@@ -0,0 +1,523 @@
+#ifndef C_PIPELINE
+#define C_PIPELINE
+
+#include "CSyncContainer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//Items travel between stages in batches stamped with the time they were queued
+template <class T>
+struct CPipelineBatch
+{
+    std::vector<T> items;
+    std::chrono::steady_clock::time_point queued;
+};
+
+template <class T>
+struct CPipelineQueue
+{
+    typedef CSyncContainer<std::queue<CPipelineBatch<T>>> type;
+    static std::shared_ptr<type> make(size_t capacity) { return std::make_shared<type>(capacity); }
+};
+
+//A sink has no output queue
+template <>
+struct CPipelineQueue<void>
+{
+    typedef void type;
+    static std::shared_ptr<type> make(size_t) { return nullptr; }
+};
+
+//Times are summed over the workers of a stage, elapsed runs from pipeline start to the stage's
+//last worker exiting (or to now while it runs). The stage with the highest utilization is the
+//bottleneck, a stage that is mostly blocked is waiting for the one after it.
+struct CStageStats
+{
+    std::string name;
+    unsigned int parallelism;
+    size_t processed;
+    size_t batches;
+    //Batches waiting in the stage's input queue
+    size_t queued;
+    std::chrono::nanoseconds busy;
+    std::chrono::nanoseconds idle;
+    std::chrono::nanoseconds blocked;
+    std::chrono::nanoseconds queueLatency;
+    std::chrono::nanoseconds maxQueueLatency;
+    std::chrono::nanoseconds elapsed;
+
+    //Items per second
+    double throughput() const;
+    //busy / (parallelism * elapsed)
+    double utilization() const;
+    //Time in the stage function per item
+    std::chrono::nanoseconds serviceTime() const;
+    //Time a batch waits in the input queue
+    std::chrono::nanoseconds meanQueueLatency() const;
+};
+
+class IPipelineStage
+{
+    public:
+        virtual ~IPipelineStage() {}
+        virtual void join() = 0;
+        virtual CStageStats stats() const = 0;
+        //Identify the queues, a stage whose output is no other stage's input is a tail
+        virtual const void* input() const = 0;
+        virtual const void* output() const = 0;
+        //Terminates the output queue, a full one then rejects pushes instead of blocking
+        virtual void abandon() = 0;
+};
+
+//parallelism workers pop batches from input, run function on each item and push the results
+//downstream in batches of up to batch items. A partial batch is sent as soon as the input runs dry,
+//so batching never holds items back. When input is terminated and drained the last worker out
+//terminates output, which carries the shutdown down the pipeline. A terminated output that rejects
+//a batch stops the stage and terminates its input, which carries the stop up the pipeline.
+template <class IN, class OUT, class FUNCTION>
+class CPipelineStage: public IPipelineStage
+{
+    typedef typename std::conditional<std::is_void<OUT>::value, char, OUT>::type output_type;
+    public:
+        CPipelineStage(const std::string& name, FUNCTION function, unsigned int parallelism, size_t batch,
+                       std::chrono::steady_clock::time_point start,
+                       std::shared_ptr<typename CPipelineQueue<IN>::type> input,
+                       std::shared_ptr<typename CPipelineQueue<OUT>::type> output);
+        ~CPipelineStage();
+        void join();
+        CStageStats stats() const;
+        const void* input() const;
+        const void* output() const;
+        void abandon();
+
+    private:
+        const std::string name_;
+        FUNCTION function_;
+        const unsigned int parallelism_;
+        const size_t batch_;
+        const std::chrono::steady_clock::time_point start_;
+        std::shared_ptr<typename CPipelineQueue<IN>::type> input_;
+        std::shared_ptr<typename CPipelineQueue<OUT>::type> output_;
+        std::vector<std::thread*> workers_;
+        std::atomic<unsigned int> active_;
+        std::atomic<int64_t> processed_;
+        std::atomic<int64_t> batches_;
+        std::atomic<int64_t> busy_;
+        std::atomic<int64_t> idle_;
+        std::atomic<int64_t> blocked_;
+        std::atomic<int64_t> queueLatency_;
+        std::atomic<int64_t> maxQueueLatency_;
+        std::atomic<int64_t> finished_;
+
+        CPipelineStage(const CPipelineStage& stage) = delete;
+
+        void work();
+        void run(IN& item, std::vector<output_type>& out, std::false_type);
+        void run(IN& item, std::vector<output_type>& out, std::true_type);
+        //Both add the time spent waiting for room downstream to blocked,
+        //false when the terminated output rejected the batch
+        bool flush(std::vector<output_type>& out, int64_t& blocked, std::false_type);
+        bool flush(std::vector<output_type>& out, int64_t& blocked, std::true_type);
+        void finish(std::false_type);
+        void finish(std::true_type);
+        static int64_t now();
+};
+
+template <class IN>
+struct CPipelineState
+{
+    explicit CPipelineState(size_t capacity);
+    ~CPipelineState();
+    void close();
+    void wait();
+
+    std::shared_ptr<typename CPipelineQueue<IN>::type> input;
+    //stage() appends while stats() and wait() walk it, stages themselves live until the destructor
+    std::mutex stagesLock;
+    std::vector<std::unique_ptr<IPipelineStage>> stages;
+    std::chrono::steady_clock::time_point start;
+    std::atomic<bool> closed;
+};
+
+//Typed builder: CPipeline<IN> is the input, every stage() returns a handle whose OUT is the
+//result type of the stage function. All handles share one pipeline, any of them can push,
+//close and wait. Stages start working as soon as they are added.
+//    CPipeline<std::string> input(1024);
+//    auto sink = input.stage("parse", parse, 2, 256, 64).stage("store", store, 4);
+//    input.push(line); ... input.close(); input.wait(); auto stats = input.stats();
+template <class IN, class OUT = IN>
+class CPipeline
+{
+    public:
+        //capacity of the input queue in batches, 0 means unbounded
+        explicit CPipeline(size_t capacity = 0);
+
+        //capacity bounds the queue to the next stage in batches, batch is the largest batch sent there
+        template <class FUNCTION>
+        CPipeline<IN, typename std::decay<decltype(std::declval<FUNCTION&>()(std::declval<OUT>()))>::type>
+        stage(const std::string& name, FUNCTION function, unsigned int parallelism = 1,
+              size_t capacity = 0, size_t batch = 1) const;
+
+        //Sleep while the input queue is full, return false once the pipeline is closed
+        bool push(const IN& item);
+        bool push(IN&& item);
+        bool push(std::vector<IN>&& items);
+        //Stops the input, stages drain what they have and terminate one after another.
+        //Pushes must not race with close.
+        void close();
+        //Joins all workers, call close first. Results of the last stage must be popped until it
+        //is drained, dropping the last handle instead discards them
+        void wait();
+        //Results of the last stage when it is not a sink, false once it is drained and terminated
+        template <class T = OUT>
+        typename std::enable_if<!std::is_void<T>::value, bool>::type pop(std::vector<T>& items);
+        std::vector<CStageStats> stats() const;
+
+    private:
+        template <class, class> friend class CPipeline;
+
+        std::shared_ptr<CPipelineState<IN>> state_;
+        std::shared_ptr<typename CPipelineQueue<OUT>::type> tail_;
+
+        CPipeline(std::shared_ptr<CPipelineState<IN>> state, std::shared_ptr<typename CPipelineQueue<OUT>::type> tail);
+};
+
+
+
+inline double CStageStats::throughput() const
+{
+    if(elapsed.count() == 0)
+        return 0;
+    return processed / std::chrono::duration<double>(elapsed).count();
+}
+
+inline double CStageStats::utilization() const
+{
+    if(elapsed.count() == 0 || parallelism == 0)
+        return 0;
+    return double(busy.count()) / (double(elapsed.count()) * parallelism);
+}
+
+inline std::chrono::nanoseconds CStageStats::serviceTime() const
+{
+    return processed == 0 ? std::chrono::nanoseconds(0) : busy / int64_t(processed);
+}
+
+inline std::chrono::nanoseconds CStageStats::meanQueueLatency() const
+{
+    return batches == 0 ? std::chrono::nanoseconds(0) : queueLatency / int64_t(batches);
+}
+
+template <class IN, class OUT, class FUNCTION>
+CPipelineStage<IN, OUT, FUNCTION>::CPipelineStage(const std::string& name, FUNCTION function, unsigned int parallelism, size_t batch,
+                                                  std::chrono::steady_clock::time_point start,
+                                                  std::shared_ptr<typename CPipelineQueue<IN>::type> input,
+                                                  std::shared_ptr<typename CPipelineQueue<OUT>::type> output)
+    :name_(name), function_(std::move(function)), parallelism_(std::max(1u, parallelism)), batch_(std::max(size_t(1), batch)), start_(start),
+     input_(std::move(input)), output_(std::move(output))
+{
+    active_.store(parallelism_);
+    processed_.store(0);
+    batches_.store(0);
+    busy_.store(0);
+    idle_.store(0);
+    blocked_.store(0);
+    queueLatency_.store(0);
+    maxQueueLatency_.store(0);
+    finished_.store(0);
+    for(unsigned int i = 0; i < parallelism_; ++i)
+        workers_.push_back(new std::thread(&CPipelineStage::work, this));
+}
+
+template <class IN, class OUT, class FUNCTION>
+CPipelineStage<IN, OUT, FUNCTION>::~CPipelineStage()
+{
+    join();
+}
+
+template <class IN, class OUT, class FUNCTION>
+void CPipelineStage<IN, OUT, FUNCTION>::join()
+{
+    for(auto th: workers_)
+    {
+        th->join();
+        delete th;
+    }
+    workers_.clear();
+}
+
+template <class IN, class OUT, class FUNCTION>
+CStageStats CPipelineStage<IN, OUT, FUNCTION>::stats() const
+{
+    CStageStats stats;
+    stats.name = name_;
+    stats.parallelism = parallelism_;
+    stats.processed = processed_.load();
+    stats.batches = batches_.load();
+    stats.queued = input_->size();
+    stats.busy = std::chrono::nanoseconds(busy_.load());
+    stats.idle = std::chrono::nanoseconds(idle_.load());
+    stats.blocked = std::chrono::nanoseconds(blocked_.load());
+    stats.queueLatency = std::chrono::nanoseconds(queueLatency_.load());
+    stats.maxQueueLatency = std::chrono::nanoseconds(maxQueueLatency_.load());
+    int64_t finished = finished_.load();
+    int64_t start = std::chrono::duration_cast<std::chrono::nanoseconds>(start_.time_since_epoch()).count();
+    stats.elapsed = std::chrono::nanoseconds((finished != 0 ? finished : now()) - start);
+    return stats;
+}
+
+template <class IN, class OUT, class FUNCTION>
+const void* CPipelineStage<IN, OUT, FUNCTION>::input() const
+{
+    return input_.get();
+}
+
+template <class IN, class OUT, class FUNCTION>
+const void* CPipelineStage<IN, OUT, FUNCTION>::output() const
+{
+    return output_.get();
+}
+
+template <class IN, class OUT, class FUNCTION>
+void CPipelineStage<IN, OUT, FUNCTION>::abandon()
+{
+    finish(std::is_void<OUT>());
+}
+
+template <class IN, class OUT, class FUNCTION>
+void CPipelineStage<IN, OUT, FUNCTION>::work()
+{
+    CPipelineBatch<IN> batch;
+    std::vector<output_type> out;
+    while(true)
+    {
+        int64_t waiting = now();
+        if(!input_->popOrSleep(batch))
+            break;
+        int64_t popped = now();
+        idle_.fetch_add(popped - waiting, std::memory_order_relaxed);
+        int64_t latency = popped - std::chrono::duration_cast<std::chrono::nanoseconds>(batch.queued.time_since_epoch()).count();
+        queueLatency_.fetch_add(latency, std::memory_order_relaxed);
+        int64_t maxLatency = maxQueueLatency_.load(std::memory_order_relaxed);
+        while(latency > maxLatency && !maxQueueLatency_.compare_exchange_weak(maxLatency, latency, std::memory_order_relaxed));
+
+        int64_t blocked = 0;
+        bool accepted = true;
+        for(auto& item: batch.items)
+        {
+            run(item, out, std::is_void<OUT>());
+            if(out.size() >= batch_ && !(accepted = flush(out, blocked, std::is_void<OUT>())))
+                break;
+        }
+        if(accepted && input_->size() == 0)
+            accepted = flush(out, blocked, std::is_void<OUT>());
+        processed_.fetch_add(batch.items.size(), std::memory_order_relaxed);
+        batches_.fetch_add(1, std::memory_order_relaxed);
+        blocked_.fetch_add(blocked, std::memory_order_relaxed);
+        busy_.fetch_add(now() - popped - blocked, std::memory_order_relaxed);
+        batch.items.clear();
+        if(!accepted)
+        {
+            //Nothing downstream takes results any more: stop, and refuse input so the stages before stop too
+            input_->terminate();
+            out.clear();
+            break;
+        }
+    }
+    int64_t blocked = 0;
+    flush(out, blocked, std::is_void<OUT>());
+    blocked_.fetch_add(blocked, std::memory_order_relaxed);
+    if(--active_ == 0)
+    {
+        finished_.store(now());
+        finish(std::is_void<OUT>());
+    }
+}
+
+template <class IN, class OUT, class FUNCTION>
+void CPipelineStage<IN, OUT, FUNCTION>::run(IN& item, std::vector<output_type>& out, std::false_type)
+{
+    out.push_back(function_(std::move(item)));
+}
+
+template <class IN, class OUT, class FUNCTION>
+void CPipelineStage<IN, OUT, FUNCTION>::run(IN& item, std::vector<output_type>&, std::true_type)
+{
+    function_(std::move(item));
+}
+
+template <class IN, class OUT, class FUNCTION>
+bool CPipelineStage<IN, OUT, FUNCTION>::flush(std::vector<output_type>& out, int64_t& blocked, std::false_type)
+{
+    if(out.empty())
+        return true;
+    int64_t start = now();
+    CPipelineBatch<OUT> batch;
+    batch.items.swap(out);
+    batch.queued = std::chrono::steady_clock::now();
+    bool accepted = output_->pushOrSleep(std::move(batch));
+    out.reserve(batch_);
+    blocked += now() - start;
+    return accepted;
+}
+
+template <class IN, class OUT, class FUNCTION>
+bool CPipelineStage<IN, OUT, FUNCTION>::flush(std::vector<output_type>&, int64_t&, std::true_type)
+{
+    return true;
+}
+
+template <class IN, class OUT, class FUNCTION>
+void CPipelineStage<IN, OUT, FUNCTION>::finish(std::false_type)
+{
+    output_->terminate();
+}
+
+template <class IN, class OUT, class FUNCTION>
+void CPipelineStage<IN, OUT, FUNCTION>::finish(std::true_type)
+{
+}
+
+template <class IN, class OUT, class FUNCTION>
+int64_t CPipelineStage<IN, OUT, FUNCTION>::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <class IN>
+CPipelineState<IN>::CPipelineState(size_t capacity)
+    :input(new typename CPipelineQueue<IN>::type(capacity)), start(std::chrono::steady_clock::now())
+{
+    closed.store(false);
+}
+
+template <class IN>
+CPipelineState<IN>::~CPipelineState()
+{
+    close();
+    //No handle is left to pop the results, a full tail would keep its stage asleep in pushOrSleep
+    for(auto& stage: stages)
+    {
+        bool consumed = false;
+        for(auto& next: stages)
+            consumed = consumed || next->input() == stage->output();
+        if(!consumed)
+            stage->abandon();
+    }
+    wait();
+}
+
+template <class IN>
+void CPipelineState<IN>::close()
+{
+    closed.store(true);
+    input->terminate();
+}
+
+template <class IN>
+void CPipelineState<IN>::wait()
+{
+    std::vector<IPipelineStage*> joined;
+    {
+        std::lock_guard<std::mutex> lock(stagesLock);
+        for(auto& stage: stages)
+            joined.push_back(stage.get());
+    }
+    for(auto stage: joined)
+        stage->join();
+}
+
+template <class IN, class OUT>
+CPipeline<IN, OUT>::CPipeline(size_t capacity)
+    :state_(new CPipelineState<IN>(capacity))
+{
+    static_assert(std::is_same<IN, OUT>::value, "Pipelines start from CPipeline<IN>");
+    tail_ = state_->input;
+}
+
+template <class IN, class OUT>
+CPipeline<IN, OUT>::CPipeline(std::shared_ptr<CPipelineState<IN>> state, std::shared_ptr<typename CPipelineQueue<OUT>::type> tail)
+    :state_(std::move(state)), tail_(std::move(tail))
+{
+}
+
+template <class IN, class OUT>
+template <class FUNCTION>
+CPipeline<IN, typename std::decay<decltype(std::declval<FUNCTION&>()(std::declval<OUT>()))>::type>
+CPipeline<IN, OUT>::stage(const std::string& name, FUNCTION function, unsigned int parallelism,
+                          size_t capacity, size_t batch) const
+{
+    typedef typename std::decay<decltype(std::declval<FUNCTION&>()(std::declval<OUT>()))>::type NEXT;
+    auto output = CPipelineQueue<NEXT>::make(capacity);
+    std::lock_guard<std::mutex> lock(state_->stagesLock);
+    state_->stages.emplace_back(new CPipelineStage<OUT, NEXT, FUNCTION>(name, std::move(function), parallelism, batch,
+                                                                         state_->start, tail_, output));
+    return CPipeline<IN, NEXT>(state_, output);
+}
+
+template <class IN, class OUT>
+bool CPipeline<IN, OUT>::push(const IN& item)
+{
+    return push(std::vector<IN>(1, item));
+}
+
+template <class IN, class OUT>
+bool CPipeline<IN, OUT>::push(IN&& item)
+{
+    std::vector<IN> items;
+    items.push_back(std::move(item));
+    return push(std::move(items));
+}
+
+template <class IN, class OUT>
+bool CPipeline<IN, OUT>::push(std::vector<IN>&& items)
+{
+    if(state_->closed.load())
+        return false;
+    CPipelineBatch<IN> batch;
+    batch.items = std::move(items);
+    batch.queued = std::chrono::steady_clock::now();
+    return state_->input->pushOrSleep(std::move(batch));
+}
+
+template <class IN, class OUT>
+void CPipeline<IN, OUT>::close()
+{
+    state_->close();
+}
+
+template <class IN, class OUT>
+void CPipeline<IN, OUT>::wait()
+{
+    state_->wait();
+}
+
+template <class IN, class OUT>
+template <class T>
+typename std::enable_if<!std::is_void<T>::value, bool>::type CPipeline<IN, OUT>::pop(std::vector<T>& items)
+{
+    CPipelineBatch<T> batch;
+    if(!tail_->popOrSleep(batch))
+        return false;
+    items = std::move(batch.items);
+    return true;
+}
+
+template <class IN, class OUT>
+std::vector<CStageStats> CPipeline<IN, OUT>::stats() const
+{
+    std::vector<CStageStats> stats;
+    std::lock_guard<std::mutex> lock(state_->stagesLock);
+    for(auto& stage: state_->stages)
+        stats.push_back(stage->stats());
+    return stats;
+}
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef C_SHARDED_SYNC_CONTAINER
+#define C_SHARDED_SYNC_CONTAINER
+
+#include "CSyncContainer.hpp"
+#include <algorithm>
+#include <vector>
+#include <memory>
+#include <random>
+#include <thread>
+
+//Relaxed-order container built from N independent CSyncContainer shards.
+//Producers stick to one shard per thread, consumers pick the fuller of two random shards
+//(power-of-two choices) and fall back to a full scan. Items from one producer keep the order
+//of their shard, there is no order across producers.
+//Consumers sleep on a single container-wide condition, so a push to any shard wakes them.
+template <class CONTAINER>
+class CShardedSyncContainer
+{
+    typedef typename CONTAINER::value_type value_type;
+    public:
+        //shards == 0 uses std::thread::hardware_concurrency()
+        explicit CShardedSyncContainer(size_t shards = 0);
+
+        void push(const value_type& item);
+        void push(value_type&& item);
+        template <class... Args>
+        void emplace(Args&&... args);
+        bool popOrSleep(value_type& item);
+        bool popNoSleep(value_type& item);
+        size_t size();
+        size_t shards() const;
+        void terminate();
+        void restart();
+
+    private:
+        std::vector<std::unique_ptr<CSyncContainer<CONTAINER>>> shards_;
+        //Both counters are incremented after the item is pushed and decremented after it is popped,
+        //so a non-zero size_ means an item can be popped and sleeping consumers never spin on an
+        //item still in flight. size_ goes up first and down last, it never drops below a shard count
+        //Padded, otherwise producers sticking to neighbouring shards share a line again
+        std::unique_ptr<CachePadded<std::atomic<size_t>>[]> shardSizes_;
+        CACHE_ALIGNED std::atomic<size_t> size_;
+        CACHE_ALIGNED std::atomic<int> sleepingConsumers_;
+        std::atomic<bool> terminated_;
+        CACHE_ALIGNED std::mutex sleepLock_;
+        std::condition_variable notEmptyFlag_;
+
+        CShardedSyncContainer(const CShardedSyncContainer& container) = delete;
+
+        size_t producerShard() const;
+        size_t randomShard() const;
+        bool popFromShard(size_t shard, value_type& item);
+};
+
+
+
+template <class CONTAINER>
+CShardedSyncContainer<CONTAINER>::CShardedSyncContainer(size_t shards)
+{
+    if(shards == 0)
+        shards = std::max(1u, std::thread::hardware_concurrency());
+    for(size_t i = 0; i < shards; ++i)
+        shards_.emplace_back(new CSyncContainer<CONTAINER>());
+    shardSizes_.reset(new CachePadded<std::atomic<size_t>>[shards]);
+    for(size_t i = 0; i < shards; ++i)
+        shardSizes_[i]->store(0);
+    size_.store(0);
+    sleepingConsumers_.store(0);
+    terminated_.store(false);
+}
+
+template <class CONTAINER>
+void CShardedSyncContainer<CONTAINER>::push(const value_type& item)
+{
+    emplace(item);
+}
+
+template <class CONTAINER>
+void CShardedSyncContainer<CONTAINER>::push(value_type&& item)
+{
+    emplace(std::move(item));
+}
+
+template <class CONTAINER>
+template <class... Args>
+void CShardedSyncContainer<CONTAINER>::emplace(Args&&... args)
+{
+    size_t shard = producerShard();
+    shards_[shard]->emplace(std::forward<Args>(args)...);
+    ++size_;
+    ++*shardSizes_[shard];
+    if(sleepingConsumers_.load() == 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(sleepLock_);
+    }
+    notEmptyFlag_.notify_one();
+}
+
+template <class CONTAINER>
+bool CShardedSyncContainer<CONTAINER>::popOrSleep(value_type& item)
+{
+    while(true)
+    {
+        if(popNoSleep(item))
+            return true;
+        std::unique_lock<std::mutex> lock(sleepLock_);
+        ++sleepingConsumers_;
+        while(size_.load() == 0 && !terminated_)
+            notEmptyFlag_.wait(lock);
+        --sleepingConsumers_;
+        if(size_.load() == 0)
+            return false;
+    }
+}
+
+template <class CONTAINER>
+bool CShardedSyncContainer<CONTAINER>::popNoSleep(value_type& item)
+{
+    if(size_.load() == 0)
+        return false;
+    size_t first = randomShard();
+    size_t second = randomShard();
+    if(shardSizes_[second]->load(std::memory_order_relaxed) > shardSizes_[first]->load(std::memory_order_relaxed))
+        std::swap(first, second);
+    if(popFromShard(first, item) || popFromShard(second, item))
+        return true;
+    for(size_t i = 1; i <= shards_.size(); ++i)
+    {
+        if(popFromShard((first + i) % shards_.size(), item))
+            return true;
+    }
+    return false;
+}
+
+template <class CONTAINER>
+size_t CShardedSyncContainer<CONTAINER>::size()
+{
+    return size_.load();
+}
+
+template <class CONTAINER>
+size_t CShardedSyncContainer<CONTAINER>::shards() const
+{
+    return shards_.size();
+}
+
+template <class CONTAINER>
+void CShardedSyncContainer<CONTAINER>::terminate()
+{
+    std::unique_lock<std::mutex> lock(sleepLock_);
+    terminated_.store(true);
+    lock.unlock();
+    notEmptyFlag_.notify_all();
+}
+
+template <class CONTAINER>
+void CShardedSyncContainer<CONTAINER>::restart()
+{
+    std::unique_lock<std::mutex> lock(sleepLock_);
+    terminated_.store(false);
+}
+
+template <class CONTAINER>
+size_t CShardedSyncContainer<CONTAINER>::producerShard() const
+{
+    static std::atomic<size_t> nextThread(0);
+    static thread_local size_t thread = nextThread++;
+    return thread % shards_.size();
+}
+
+template <class CONTAINER>
+size_t CShardedSyncContainer<CONTAINER>::randomShard() const
+{
+    static thread_local std::minstd_rand generator(std::hash<std::thread::id>()(std::this_thread::get_id()));
+    return generator() % shards_.size();
+}
+
+template <class CONTAINER>
+bool CShardedSyncContainer<CONTAINER>::popFromShard(size_t shard, value_type& item)
+{
+    if(shardSizes_[shard]->load() == 0)
+        return false;
+    if(!shards_[shard]->popNoSleep(item))
+        return false;
+    --*shardSizes_[shard];
+    --size_;
+    return true;
+}
+
+#endif
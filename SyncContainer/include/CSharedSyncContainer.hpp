@@ -0,0 +1,709 @@
+#ifndef C_SHARED_SYNC_CONTAINER
+#define C_SHARED_SYNC_CONTAINER
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//Identity of the calling process as recorded in shared slots: pid << 32 | the low half of its start
+//time (field 22 of /proc/<pid>/stat), so a pid reused by an unrelated process does not pass for the
+//holder. The identity is cached, and the cache is dropped in a pthread_atfork child handler, so a
+//container created before fork() stamps slots with the child's own identity.
+//A process counts as dead once it is gone or a zombie, whether or not its parent has reaped it.
+//Without /proc the check falls back to kill(pid, 0), which takes reused pids and zombies for alive.
+class CSharedProcess
+{
+    public:
+        static uint64_t id();
+        static int32_t pid();
+        static bool isDead(uint64_t id);
+        //Pid only, a reused pid passes for the process
+        static bool isDead(int32_t pid);
+
+    private:
+        static std::atomic<uint64_t>& cached();
+        static void forget();
+        //State and start time from /proc/<pid>/stat, false when it cannot be read
+        static bool status(int32_t pid, char& state, uint64_t& start);
+};
+
+//Eventcount for waiters in different processes: lives in shared memory and sleeps on a
+//futex word, a notify without waiters is a fence and a load, no syscall.
+//Waiters are also counted per process, so releaseDead() can take back the ones a killed process
+//left behind, they would make every notify a syscall. A crash between the two counts leaks one
+//waiter, and waiters of more than PROCESSES processes at once are counted only globally.
+//Entries hold the pid alone, the waiters of a dead process whose pid was reused stay until it exits.
+struct CSharedEventCount
+{
+    static const int PROCESSES = 32;
+
+    std::atomic<uint32_t> epoch;
+    std::atomic<uint32_t> waiters;
+    //pid << 32 | waiters of that pid, 0 when free
+    std::atomic<uint64_t> processes[PROCESSES];
+
+    void initialize();
+    uint32_t prepareWait();
+    void cancelWait();
+    void wait(uint32_t key);
+    void notify(bool all = false);
+    //Callers serialize it with attach and recover (flock)
+    void releaseDead();
+    void addWaiter();
+    void removeWaiter();
+};
+
+//Bounded FIFO of trivially copyable T shared between processes through a POSIX shared memory
+//segment. Elements live in a ring of slots with per-slot sequence numbers (Vyukov), producers and
+//consumers claim slots with one CAS and touch the kernel only to sleep or to wake a sleeper.
+//beginPush/commitPush and beginPop/endPop hand out the slot itself, so a message is written once
+//by its producer and read in place by its consumer.
+//Every claimed slot records the CSharedProcess::id() that holds it. Attaching (and recover()) releases
+//slots and eventcount waiters held by processes that no longer exist, zombies included: an unfinished
+//push is skipped by consumers, an unfinished pop frees its slot and the message is lost. A crash in
+//the few instructions between claiming a slot and recording the id cannot be detected. The segment itself is (re)initialized under flock, so a
+//creator that dies half way is replaced by the next process to attach.
+template <class T>
+class CSharedSyncContainer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "CSharedSyncContainer copies T between processes");
+    public:
+        //Creates segment name with room for capacity elements (rounded up to a power of two)
+        //or attaches to an existing one, throws std::system_error on failure or layout mismatch
+        CSharedSyncContainer(const std::string& name, size_t capacity);
+        //Unmaps, the segment stays until unlink
+        ~CSharedSyncContainer();
+        static void unlink(const std::string& name);
+
+        bool pushOrSleep(const T& item);
+        bool tryPush(const T& item);
+        bool popOrSleep(T& item);
+        bool popNoSleep(T& item);
+
+        //Zero-copy: the returned slot belongs to the caller until commitPush/endPop,
+        //nullptr when full/empty (try) or full/drained and terminated (OrSleep)
+        T* beginPushOrSleep();
+        T* tryBeginPush();
+        void commitPush(T* item);
+        const T* beginPopOrSleep();
+        const T* tryBeginPop();
+        void endPop(const T* item);
+
+        size_t size() const;
+        size_t capacity() const;
+        void terminate();
+        void restart();
+        bool isTerminated() const;
+        //Releases slots held by dead processes, returns how many. Holders are told apart by pid and
+        //start time, so only a system without /proc mistakes a reused pid or a zombie for the holder
+        size_t recover();
+
+    private:
+        static const uint64_t MAGIC = 0x53796e63436f6e74ull;
+        //A literal rather than CACHE_LINE_SIZE: processes built with different tuning must agree on the layout
+        static const size_t CACHE_LINE = 64;
+
+        struct Header
+        {
+            uint64_t magic;
+            uint64_t capacity;
+            uint64_t elementSize;
+            std::atomic<uint32_t> ready;
+            std::atomic<uint32_t> terminated;
+            alignas(CACHE_LINE) std::atomic<uint64_t> enqueuePosition;
+            alignas(CACHE_LINE) std::atomic<uint64_t> dequeuePosition;
+            alignas(CACHE_LINE) CSharedEventCount notEmpty;
+            alignas(CACHE_LINE) CSharedEventCount notFull;
+        };
+
+        struct Slot
+        {
+            //position when free for the lap's producer, position + 1 when it holds a message
+            std::atomic<uint64_t> sequence;
+            //CSharedProcess::id() of the holder, 0 when unclaimed
+            std::atomic<uint64_t> writer;
+            std::atomic<uint64_t> reader;
+            std::atomic<uint64_t> writerPosition;
+            std::atomic<uint64_t> readerPosition;
+            //Set by recovery on a push that never committed
+            std::atomic<uint32_t> abandoned;
+            T data;
+        };
+
+        int fd_;
+        size_t mappedSize_;
+        Header* header_;
+        Slot* slots_;
+        uint64_t mask_;
+
+        CSharedSyncContainer(const CSharedSyncContainer& container) = delete;
+
+        void attach(const std::string& name, size_t capacity);
+        void initialize(size_t capacity);
+        size_t recoverLocked();
+        Slot* slotOf(const T* item) const;
+        Slot* claimPush();
+        Slot* claimPop();
+        static size_t roundUp(size_t capacity);
+        static void fail(const std::string& what, int error);
+};
+
+
+
+inline uint64_t CSharedProcess::id()
+{
+    uint64_t id = cached().load(std::memory_order_relaxed);
+    if(id != 0)
+        return id;
+    int32_t pid = getpid();
+    char state;
+    uint64_t start = 0;
+    status(pid, state, start);
+    id = uint64_t(uint32_t(pid)) << 32 | uint32_t(start);
+    cached().store(id, std::memory_order_relaxed);
+    return id;
+}
+
+inline int32_t CSharedProcess::pid()
+{
+    return int32_t(id() >> 32);
+}
+
+inline bool CSharedProcess::isDead(uint64_t id)
+{
+    char state;
+    uint64_t start;
+    if(!status(int32_t(id >> 32), state, start))
+        return isDead(int32_t(id >> 32));
+    return state == 'Z' || state == 'X' || uint32_t(start) != uint32_t(id);
+}
+
+inline bool CSharedProcess::isDead(int32_t pid)
+{
+    char state;
+    uint64_t start;
+    if(status(pid, state, start))
+        return state == 'Z' || state == 'X';
+    return kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+inline std::atomic<uint64_t>& CSharedProcess::cached()
+{
+    static std::atomic<uint64_t> id(0);
+    static int registered = pthread_atfork(nullptr, nullptr, &CSharedProcess::forget);
+    (void)registered;
+    return id;
+}
+
+inline void CSharedProcess::forget()
+{
+    cached().store(0, std::memory_order_relaxed);
+}
+
+inline bool CSharedProcess::status(int32_t pid, char& state, uint64_t& start)
+{
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/%d/stat", int(pid));
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
+        return false;
+    char buffer[1024];
+    ssize_t length = read(fd, buffer, sizeof(buffer) - 1);
+    close(fd);
+    if(length <= 0)
+        return false;
+    buffer[length] = '\0';
+    //The command name may hold spaces and parentheses, field 3 starts after the last ')'
+    const char* field = strrchr(buffer, ')');
+    if(field == nullptr || field[1] != ' ')
+        return false;
+    field += 2;
+    state = *field;
+    for(int i = 3; i < 22; ++i)
+    {
+        field = strchr(field, ' ');
+        if(field == nullptr)
+            return false;
+        ++field;
+    }
+    start = strtoull(field, nullptr, 10);
+    return true;
+}
+
+inline void CSharedEventCount::initialize()
+{
+    epoch.store(0);
+    waiters.store(0);
+    for(auto& process: processes)
+        process.store(0);
+}
+
+inline uint32_t CSharedEventCount::prepareWait()
+{
+    addWaiter();
+    return epoch.load();
+}
+
+inline void CSharedEventCount::cancelWait()
+{
+    removeWaiter();
+}
+
+inline void CSharedEventCount::wait(uint32_t key)
+{
+    //Not FUTEX_PRIVATE_FLAG, the word is shared between processes
+    while(epoch.load() == key)
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAIT, key, nullptr, nullptr, 0);
+    removeWaiter();
+}
+
+inline void CSharedEventCount::notify(bool all)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(waiters.load(std::memory_order_relaxed) == 0)
+        return;
+    epoch.fetch_add(1);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&epoch), FUTEX_WAKE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+}
+
+inline void CSharedEventCount::releaseDead()
+{
+    for(auto& process: processes)
+    {
+        uint64_t entry = process.load();
+        if(entry != 0 && CSharedProcess::isDead(int32_t(entry >> 32)) && process.compare_exchange_strong(entry, 0))
+            waiters.fetch_sub(uint32_t(entry));
+    }
+}
+
+//Global count first: a crash in between leaks a waiter rather than releasing one twice
+inline void CSharedEventCount::addWaiter()
+{
+    waiters.fetch_add(1);
+    uint64_t pid = uint32_t(CSharedProcess::pid());
+    //The process's own entry, else a free one
+    for(int pass = 0; pass < 2; ++pass)
+        for(auto& process: processes)
+        {
+            uint64_t entry = process.load();
+            while(pass == 0 ? entry >> 32 == pid : entry == 0)
+            {
+                if(process.compare_exchange_weak(entry, (pass == 0 ? entry : pid << 32) + 1))
+                    return;
+            }
+        }
+}
+
+inline void CSharedEventCount::removeWaiter()
+{
+    uint64_t pid = uint32_t(CSharedProcess::pid());
+    for(auto& process: processes)
+    {
+        uint64_t entry = process.load();
+        while(entry >> 32 == pid)
+        {
+            if(process.compare_exchange_weak(entry, uint32_t(entry) == 1 ? 0 : entry - 1))
+            {
+                waiters.fetch_sub(1);
+                return;
+            }
+        }
+    }
+    waiters.fetch_sub(1);
+}
+
+template <class T>
+CSharedSyncContainer<T>::CSharedSyncContainer(const std::string& name, size_t capacity)
+    :fd_(-1), mappedSize_(0), header_(nullptr), slots_(nullptr)
+{
+    //Registers the fork handler before the caller can fork
+    CSharedProcess::id();
+    try
+    {
+        attach(name, roundUp(capacity));
+    }
+    catch(...)
+    {
+        if(header_ != nullptr)
+            munmap(header_, mappedSize_);
+        if(fd_ >= 0)
+            close(fd_);
+        throw;
+    }
+}
+
+template <class T>
+CSharedSyncContainer<T>::~CSharedSyncContainer()
+{
+    munmap(header_, mappedSize_);
+    close(fd_);
+}
+
+template <class T>
+void CSharedSyncContainer<T>::unlink(const std::string& name)
+{
+    shm_unlink(name.c_str());
+}
+
+template <class T>
+bool CSharedSyncContainer<T>::pushOrSleep(const T& item)
+{
+    T* slot = beginPushOrSleep();
+    if(slot == nullptr)
+        return false;
+    std::memcpy(static_cast<void*>(slot), &item, sizeof(T));
+    commitPush(slot);
+    return true;
+}
+
+template <class T>
+bool CSharedSyncContainer<T>::tryPush(const T& item)
+{
+    T* slot = tryBeginPush();
+    if(slot == nullptr)
+        return false;
+    std::memcpy(static_cast<void*>(slot), &item, sizeof(T));
+    commitPush(slot);
+    return true;
+}
+
+template <class T>
+bool CSharedSyncContainer<T>::popOrSleep(T& item)
+{
+    const T* slot = beginPopOrSleep();
+    if(slot == nullptr)
+        return false;
+    std::memcpy(static_cast<void*>(&item), slot, sizeof(T));
+    endPop(slot);
+    return true;
+}
+
+template <class T>
+bool CSharedSyncContainer<T>::popNoSleep(T& item)
+{
+    const T* slot = tryBeginPop();
+    if(slot == nullptr)
+        return false;
+    std::memcpy(static_cast<void*>(&item), slot, sizeof(T));
+    endPop(slot);
+    return true;
+}
+
+template <class T>
+T* CSharedSyncContainer<T>::beginPushOrSleep()
+{
+    while(true)
+    {
+        Slot* slot = claimPush();
+        if(slot != nullptr)
+            return &slot->data;
+        if(header_->terminated.load())
+            return nullptr;
+        uint32_t key = header_->notFull.prepareWait();
+        slot = claimPush();
+        if(slot != nullptr)
+        {
+            header_->notFull.cancelWait();
+            return &slot->data;
+        }
+        if(header_->terminated.load())
+        {
+            header_->notFull.cancelWait();
+            return nullptr;
+        }
+        header_->notFull.wait(key);
+    }
+}
+
+template <class T>
+T* CSharedSyncContainer<T>::tryBeginPush()
+{
+    Slot* slot = claimPush();
+    return slot == nullptr ? nullptr : &slot->data;
+}
+
+template <class T>
+void CSharedSyncContainer<T>::commitPush(T* item)
+{
+    Slot* slot = slotOf(item);
+    slot->sequence.store(slot->writerPosition.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    slot->writer.store(0, std::memory_order_relaxed);
+    header_->notEmpty.notify();
+}
+
+template <class T>
+const T* CSharedSyncContainer<T>::beginPopOrSleep()
+{
+    while(true)
+    {
+        Slot* slot = claimPop();
+        if(slot != nullptr)
+            return &slot->data;
+        uint32_t key = header_->notEmpty.prepareWait();
+        bool terminated = header_->terminated.load();
+        slot = claimPop();
+        if(slot != nullptr || terminated)
+        {
+            header_->notEmpty.cancelWait();
+            return slot == nullptr ? nullptr : &slot->data;
+        }
+        header_->notEmpty.wait(key);
+    }
+}
+
+template <class T>
+const T* CSharedSyncContainer<T>::tryBeginPop()
+{
+    Slot* slot = claimPop();
+    return slot == nullptr ? nullptr : &slot->data;
+}
+
+template <class T>
+void CSharedSyncContainer<T>::endPop(const T* item)
+{
+    Slot* slot = slotOf(item);
+    slot->sequence.store(slot->readerPosition.load(std::memory_order_relaxed) + mask_ + 1, std::memory_order_release);
+    slot->reader.store(0, std::memory_order_relaxed);
+    header_->notFull.notify();
+}
+
+template <class T>
+size_t CSharedSyncContainer<T>::size() const
+{
+    uint64_t dequeued = header_->dequeuePosition.load();
+    uint64_t enqueued = header_->enqueuePosition.load();
+    return enqueued > dequeued ? enqueued - dequeued : 0;
+}
+
+template <class T>
+size_t CSharedSyncContainer<T>::capacity() const
+{
+    return mask_ + 1;
+}
+
+template <class T>
+void CSharedSyncContainer<T>::terminate()
+{
+    header_->terminated.store(1);
+    header_->notEmpty.notify(true);
+    header_->notFull.notify(true);
+}
+
+template <class T>
+void CSharedSyncContainer<T>::restart()
+{
+    header_->terminated.store(0);
+}
+
+template <class T>
+bool CSharedSyncContainer<T>::isTerminated() const
+{
+    return header_->terminated.load() != 0;
+}
+
+template <class T>
+size_t CSharedSyncContainer<T>::recover()
+{
+    flock(fd_, LOCK_EX);
+    size_t recovered = recoverLocked();
+    flock(fd_, LOCK_UN);
+    return recovered;
+}
+
+template <class T>
+void CSharedSyncContainer<T>::attach(const std::string& name, size_t capacity)
+{
+    size_t slotsOffset = (sizeof(Header) + alignof(Slot) - 1) / alignof(Slot) * alignof(Slot);
+    mappedSize_ = slotsOffset + capacity * sizeof(Slot);
+    fd_ = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    if(fd_ < 0)
+        fail("shm_open " + name, errno);
+    //Creation, initialization and recovery are serialized, a crashed holder releases the lock with its fd
+    if(flock(fd_, LOCK_EX) != 0)
+        fail("flock " + name, errno);
+    struct stat info;
+    if(fstat(fd_, &info) != 0)
+        fail("fstat " + name, errno);
+    if(info.st_size != 0 && size_t(info.st_size) != mappedSize_)
+        fail("layout of " + name, EINVAL);
+    if(info.st_size == 0 && ftruncate(fd_, mappedSize_) != 0)
+        fail("ftruncate " + name, errno);
+    void* memory = mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if(memory == MAP_FAILED)
+        fail("mmap " + name, errno);
+    header_ = static_cast<Header*>(memory);
+    slots_ = reinterpret_cast<Slot*>(static_cast<char*>(memory) + slotsOffset);
+    mask_ = capacity - 1;
+    if(header_->ready.load() == 0 || header_->magic != MAGIC)
+        initialize(capacity);
+    else if(header_->capacity != capacity || header_->elementSize != sizeof(T))
+        fail("layout of " + name, EINVAL);
+    else
+        recoverLocked();
+    flock(fd_, LOCK_UN);
+}
+
+template <class T>
+void CSharedSyncContainer<T>::initialize(size_t capacity)
+{
+    header_->ready.store(0);
+    header_->magic = MAGIC;
+    header_->capacity = capacity;
+    header_->elementSize = sizeof(T);
+    header_->terminated.store(0);
+    header_->enqueuePosition.store(0);
+    header_->dequeuePosition.store(0);
+    header_->notEmpty.initialize();
+    header_->notFull.initialize();
+    for(size_t i = 0; i < capacity; ++i)
+    {
+        Slot* slot = new (&slots_[i]) Slot();
+        slot->sequence.store(i);
+        slot->writer.store(0);
+        slot->reader.store(0);
+        slot->writerPosition.store(0);
+        slot->readerPosition.store(0);
+        slot->abandoned.store(0);
+    }
+    header_->ready.store(1);
+}
+
+template <class T>
+size_t CSharedSyncContainer<T>::recoverLocked()
+{
+    size_t recovered = 0;
+    for(size_t i = 0; i <= mask_; ++i)
+    {
+        Slot& slot = slots_[i];
+        uint64_t writer = slot.writer.load();
+        if(writer != 0 && CSharedProcess::isDead(writer))
+        {
+            //Claimed but never committed: publish it as a hole that consumers skip
+            uint64_t position = slot.writerPosition.load();
+            if(slot.sequence.load() == position)
+            {
+                slot.abandoned.store(1);
+                slot.sequence.store(position + 1, std::memory_order_release);
+                ++recovered;
+            }
+            slot.writer.store(0);
+        }
+        uint64_t reader = slot.reader.load();
+        if(reader != 0 && CSharedProcess::isDead(reader))
+        {
+            uint64_t position = slot.readerPosition.load();
+            if(slot.sequence.load() == position + 1)
+            {
+                slot.sequence.store(position + mask_ + 1, std::memory_order_release);
+                ++recovered;
+            }
+            slot.reader.store(0);
+        }
+    }
+    header_->notEmpty.releaseDead();
+    header_->notFull.releaseDead();
+    if(recovered != 0)
+    {
+        header_->notEmpty.notify(true);
+        header_->notFull.notify(true);
+    }
+    return recovered;
+}
+
+template <class T>
+typename CSharedSyncContainer<T>::Slot* CSharedSyncContainer<T>::slotOf(const T* item) const
+{
+    return reinterpret_cast<Slot*>(reinterpret_cast<char*>(const_cast<T*>(item)) - offsetof(Slot, data));
+}
+
+template <class T>
+typename CSharedSyncContainer<T>::Slot* CSharedSyncContainer<T>::claimPush()
+{
+    uint64_t position = header_->enqueuePosition.load(std::memory_order_relaxed);
+    while(true)
+    {
+        Slot& slot = slots_[position & mask_];
+        int64_t difference = int64_t(slot.sequence.load(std::memory_order_acquire) - position);
+        if(difference == 0)
+        {
+            if(header_->enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                slot.writerPosition.store(position, std::memory_order_relaxed);
+                slot.writer.store(CSharedProcess::id(), std::memory_order_relaxed);
+                return &slot;
+            }
+        }
+        else if(difference < 0)
+            return nullptr;
+        else
+            position = header_->enqueuePosition.load(std::memory_order_relaxed);
+    }
+}
+
+template <class T>
+typename CSharedSyncContainer<T>::Slot* CSharedSyncContainer<T>::claimPop()
+{
+    uint64_t position = header_->dequeuePosition.load(std::memory_order_relaxed);
+    while(true)
+    {
+        Slot& slot = slots_[position & mask_];
+        int64_t difference = int64_t(slot.sequence.load(std::memory_order_acquire) - (position + 1));
+        if(difference == 0)
+        {
+            if(header_->dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                if(slot.abandoned.load(std::memory_order_relaxed) != 0)
+                {
+                    //Hole left by a producer that died mid-push
+                    slot.abandoned.store(0, std::memory_order_relaxed);
+                    slot.sequence.store(position + mask_ + 1, std::memory_order_release);
+                    header_->notFull.notify();
+                    position = header_->dequeuePosition.load(std::memory_order_relaxed);
+                    continue;
+                }
+                slot.readerPosition.store(position, std::memory_order_relaxed);
+                slot.reader.store(CSharedProcess::id(), std::memory_order_relaxed);
+                return &slot;
+            }
+        }
+        else if(difference < 0)
+            return nullptr;
+        else
+            position = header_->dequeuePosition.load(std::memory_order_relaxed);
+    }
+}
+
+template <class T>
+size_t CSharedSyncContainer<T>::roundUp(size_t capacity)
+{
+    size_t rounded = 1;
+    while(rounded < capacity)
+        rounded <<= 1;
+    return rounded;
+}
+
+template <class T>
+void CSharedSyncContainer<T>::fail(const std::string& what, int error)
+{
+    throw std::system_error(error, std::system_category(), "CSharedSyncContainer: " + what);
+}
+
+#endif
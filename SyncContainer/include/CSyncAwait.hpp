@@ -0,0 +1,261 @@
+#ifndef C_SYNC_AWAIT
+#define C_SYNC_AWAIT
+
+//co_await container.pop(executor) is only available when the compiler implements C++20 coroutines,
+//CSyncContainer declares it under SYNC_CONTAINER_COROUTINES
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#define SYNC_CONTAINER_COROUTINES
+#endif
+#endif
+
+#ifdef SYNC_CONTAINER_COROUTINES
+
+#include "CSyncListeners.hpp"
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <optional>
+
+//Decides where a coroutine woken by a push or by terminate continues.
+//resume is called on the producer's thread and must not run the coroutine inline
+//if the coroutine may push into the container it waited on.
+class ISyncExecutor
+{
+    public:
+        virtual ~ISyncExecutor() {}
+        virtual void resume(std::coroutine_handle<> handle) = 0;
+};
+
+//Fire-and-forget coroutine type for consumers, the frame frees itself when the body returns
+struct CSyncTask
+{
+    struct promise_type
+    {
+        CSyncTask get_return_object()
+        {
+            return CSyncTask();
+        }
+        std::suspend_never initial_suspend() noexcept
+        {
+            return std::suspend_never();
+        }
+        std::suspend_never final_suspend() noexcept
+        {
+            return std::suspend_never();
+        }
+        void return_void() {}
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+template <class SOURCE, class T>
+class CSyncAwaiters;
+
+//Result of container.pop(executor). Completes with the item, or with std::nullopt once the
+//container is terminated and drained. An item that is already there is taken without suspending.
+template <class SOURCE, class T>
+class CPopAwaiter
+{
+    public:
+        CPopAwaiter(SOURCE& source, CSyncAwaiters<SOURCE, T>& awaiters, ISyncExecutor& executor):
+            source_(source), awaiters_(awaiters), executor_(executor), next_(nullptr) {}
+
+        bool await_ready();
+        bool await_suspend(std::coroutine_handle<> handle);
+        std::optional<T> await_resume();
+
+    private:
+        friend class CSyncAwaiters<SOURCE, T>;
+
+        SOURCE& source_;
+        CSyncAwaiters<SOURCE, T>& awaiters_;
+        ISyncExecutor& executor_;
+        std::coroutine_handle<> handle_;
+        CPopAwaiter* next_;
+        std::optional<T> item_;
+};
+
+//Suspended pop() calls of one container, kept as an intrusive FIFO inside the awaiters' frames.
+//It listens to its container like CSyncSelector does, so a push hands the item straight to the
+//oldest waiter and schedules it on that waiter's executor; terminate schedules everyone.
+//Attaches on the first pop(), containers that are never awaited pay nothing, and arms the container
+//only while the list is not empty.
+template <class SOURCE, class T>
+class CSyncAwaiters: private ISyncListener
+{
+    public:
+        CSyncAwaiters();
+        ~CSyncAwaiters();
+
+        CPopAwaiter<SOURCE, T> pop(SOURCE& source, ISyncExecutor& executor);
+
+    private:
+        friend class CPopAwaiter<SOURCE, T>;
+
+        std::mutex lock_;
+        CPopAwaiter<SOURCE, T>* head_;
+        CPopAwaiter<SOURCE, T>* tail_;
+        SOURCE* source_;
+        std::once_flag attached_;
+        //Changes under lock_, the list is not empty
+        std::atomic<bool> armed_;
+
+        CSyncAwaiters(const CSyncAwaiters& awaiters) = delete;
+
+        void notify(bool all);
+        bool armed() const;
+        //Queues awaiter unless an item or termination is already there, returns whether it was queued
+        bool suspend(CPopAwaiter<SOURCE, T>* awaiter);
+        //Matches queued awaiters with items under lock_, returns the list to resume once lock_ is released
+        CPopAwaiter<SOURCE, T>* dispatchLocked(bool all);
+        static void resume(CPopAwaiter<SOURCE, T>* ready);
+};
+
+
+
+template <class SOURCE, class T>
+bool CPopAwaiter<SOURCE, T>::await_ready()
+{
+    T item;
+    if(!source_.popNoSleep(item))
+        return false;
+    item_.emplace(std::move(item));
+    return true;
+}
+
+template <class SOURCE, class T>
+bool CPopAwaiter<SOURCE, T>::await_suspend(std::coroutine_handle<> handle)
+{
+    handle_ = handle;
+    return awaiters_.suspend(this);
+}
+
+template <class SOURCE, class T>
+std::optional<T> CPopAwaiter<SOURCE, T>::await_resume()
+{
+    return std::move(item_);
+}
+
+template <class SOURCE, class T>
+CSyncAwaiters<SOURCE, T>::CSyncAwaiters():head_(nullptr), tail_(nullptr), source_(nullptr)
+{
+    armed_.store(false);
+}
+
+template <class SOURCE, class T>
+CSyncAwaiters<SOURCE, T>::~CSyncAwaiters()
+{
+    if(source_ != nullptr)
+        source_->detach(this);
+}
+
+template <class SOURCE, class T>
+CPopAwaiter<SOURCE, T> CSyncAwaiters<SOURCE, T>::pop(SOURCE& source, ISyncExecutor& executor)
+{
+    std::call_once(attached_, [this, &source](){
+        source_ = &source;
+        source.attach(this);
+    });
+    return CPopAwaiter<SOURCE, T>(source, *this, executor);
+}
+
+template <class SOURCE, class T>
+void CSyncAwaiters<SOURCE, T>::notify(bool all)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    CPopAwaiter<SOURCE, T>* ready = dispatchLocked(all);
+    lock.unlock();
+    resume(ready);
+}
+
+template <class SOURCE, class T>
+bool CSyncAwaiters<SOURCE, T>::armed() const
+{
+    return armed_.load();
+}
+
+template <class SOURCE, class T>
+bool CSyncAwaiters<SOURCE, T>::suspend(CPopAwaiter<SOURCE, T>* awaiter)
+{
+    std::unique_lock<std::mutex> lock(lock_);
+    //Armed before the last look, a push it misses notifies us
+    if(!armed_.load())
+    {
+        armed_.store(true);
+        source_->arm();
+    }
+    //Same order as popOrSleep: termination first, then the last look for an item
+    bool terminated = source_->isTerminated();
+    T item;
+    bool popped = source_->popNoSleep(item);
+    if(popped || terminated)
+    {
+        if(head_ == nullptr)
+        {
+            armed_.store(false);
+            source_->disarm();
+        }
+        if(popped)
+            awaiter->item_.emplace(std::move(item));
+        return false;
+    }
+    //Items pushed from here on find the awaiter in the list
+    if(tail_ == nullptr)
+        head_ = awaiter;
+    else
+        tail_->next_ = awaiter;
+    tail_ = awaiter;
+    return true;
+}
+
+template <class SOURCE, class T>
+CPopAwaiter<SOURCE, T>* CSyncAwaiters<SOURCE, T>::dispatchLocked(bool all)
+{
+    CPopAwaiter<SOURCE, T>* ready = nullptr;
+    CPopAwaiter<SOURCE, T>** last = &ready;
+    while(head_ != nullptr)
+    {
+        bool terminated = all && source_->isTerminated();
+        T item;
+        if(source_->popNoSleep(item))
+            head_->item_.emplace(std::move(item));
+        else if(!terminated)
+            break;
+        CPopAwaiter<SOURCE, T>* awaiter = head_;
+        head_ = awaiter->next_;
+        awaiter->next_ = nullptr;
+        *last = awaiter;
+        last = &awaiter->next_;
+    }
+    if(head_ == nullptr)
+    {
+        tail_ = nullptr;
+        if(armed_.load())
+        {
+            armed_.store(false);
+            source_->disarm();
+        }
+    }
+    return ready;
+}
+
+template <class SOURCE, class T>
+void CSyncAwaiters<SOURCE, T>::resume(CPopAwaiter<SOURCE, T>* ready)
+{
+    while(ready != nullptr)
+    {
+        //The frame holding the awaiter may be gone as soon as it is resumed
+        CPopAwaiter<SOURCE, T>* next = ready->next_;
+        ready->executor_.resume(ready->handle_);
+        ready = next;
+    }
+}
+
+#endif
+
+#endif
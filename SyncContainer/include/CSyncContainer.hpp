@@ -5,166 +5,403 @@
 #include <stack>
 #include <mutex>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <utility>
+#include "CAdaptiveSpin.hpp"
+#include "CContainerTraits.hpp"
+#include "CSyncListeners.hpp"
+#include "CSyncAwait.hpp"
+#include "CSyncMetrics.hpp"
+#include <CachePadded.hpp>
 
-template <class CONTAINER>
+//Backend policies: CLockingBackend guards a std container with a mutex (two locks for std::queue),
+//CLockFreeBackend maps std::queue/std::stack onto LockFreeQueue/LockFreeStack (CSyncContainerLockFree.hpp),
+//CFineGrainedBackend maps std::priority_queue onto CConcurrentHeap (CSyncContainerHeap.hpp)
+struct CLockingBackend {};
+struct CLockFreeBackend {};
+struct CFineGrainedBackend {};
+
+template <class CONTAINER, class BACKEND = CLockingBackend, class Enable = void>
 class CSyncContainer
 {
+    static_assert(std::is_same<BACKEND, CLockingBackend>::value,
+                  "No structure for this BACKEND and CONTAINER, include CSyncContainerLockFree.hpp or CSyncContainerHeap.hpp");
     typedef typename CONTAINER::value_type value_type;
     public:
-        CSyncContainer();
+        //capacity == 0 means unbounded
+        explicit CSyncContainer(size_t capacity = 0);
 
-        void push(value_type item);
+        //push ignores capacity, bounded producers should use pushOrSleep/tryPush/pushFor
+        void push(const value_type& item);
+        void push(value_type&& item);
+        template <class... Args>
+        void emplace(Args&&... args);
+        //Rvalue overloads leave item untouched when they return false
+        bool pushOrSleep(const value_type& item);
+        bool pushOrSleep(value_type&& item);
+        bool tryPush(const value_type& item);
+        bool tryPush(value_type&& item);
+        template <class Rep, class Period>
+        bool pushFor(const value_type& item, const std::chrono::duration<Rep, Period>& timeout);
+        template <class Rep, class Period>
+        bool pushFor(value_type&& item, const std::chrono::duration<Rep, Period>& timeout);
+        //Pops move the element out of the container into item
         bool popOrSleep(value_type& item);
         bool popNoSleep(value_type& item);
+        template <class Rep, class Period>
+        bool popFor(value_type& item, const std::chrono::duration<Rep, Period>& timeout);
+        template <class Clock, class Duration>
+        bool popUntil(value_type& item, const std::chrono::time_point<Clock, Duration>& deadline);
         size_t size();
+        size_t capacity() const;
+        //Counters from CSyncMetrics.hpp, read without taking any lock. Only depth is filled
+        //unless SYNC_CONTAINER_METRICS is defined
+        CSyncMetricsSnapshot metrics() const;
         void terminate();
         void restart();
+        //Upper bound for the spin phase of popOrSleep, 0 makes consumers sleep right away
+        void setMaxSpin(std::chrono::nanoseconds maxSpin);
+        bool isTerminated() const;
+        //Armed listeners are told about pushes and termination, see CSyncSelector
+        void attach(ISyncListener* listener);
+        void detach(ISyncListener* listener);
+        //Listeners arm before their last check for an item and disarm after waking
+        void arm();
+        void disarm();
+#ifdef SYNC_CONTAINER_COROUTINES
+        //co_await pop(executor) suspends without blocking a thread, see CSyncAwait.hpp
+        CPopAwaiter<CSyncContainer, value_type> pop(ISyncExecutor& executor);
+#endif
 
     private:
-        CONTAINER container_;
+        //Touched under containerLock_ only
         std::mutex containerLock_;
+        CONTAINER container_;
+        const size_t capacity_;
+        int sleepingConsumers_;
+        int sleepingProducers_;
         std::condition_variable notEmptyFlag_;
-        std::atomic<bool> terminated_;
-
-        template <typename T = CONTAINER>
-        typename std::enable_if<
-                      std::is_same<std::queue<typename CONTAINER::value_type>, T>::value ||
-                      std::is_same<std::stack<typename CONTAINER::value_type>, T>::value>::type
-        pushToContainer(T& container, value_type item);
-        template <typename T = CONTAINER>
-        typename std::enable_if<
-                      !(std::is_same<std::queue<typename CONTAINER::value_type>, T>::value ||
-                      std::is_same<std::stack<typename CONTAINER::value_type>, T>::value)>::type
-        popFromContainer(T& container, value_type& item);
-
-        template <typename T = CONTAINER>
-        typename std::enable_if<
-                      !(std::is_same<std::queue<typename CONTAINER::value_type>, T>::value ||
-                      std::is_same<std::stack<typename CONTAINER::value_type>, T>::value)>::type
-        pushToContainer(T& container, value_type item);
-
-        template <typename T = CONTAINER>
-        typename std::enable_if<
-                      std::is_same<std::queue<typename CONTAINER::value_type>, T>::value>::type
-        popFromContainer(T& container, value_type& item);
-
-        template <typename T = CONTAINER>
-        typename std::enable_if<
-                      std::is_same<std::stack<typename CONTAINER::value_type>, T>::value>::type
-        popFromContainer(T& container, value_type& item);
+        std::condition_variable notFullFlag_;
+        //Polled by spinning consumers, off the line the lock holder keeps writing
+        CACHE_ALIGNED std::atomic<bool> terminated_;
+        //Mirrors container_.size() so that spinning consumers can poll it without the lock
+        std::atomic<size_t> size_;
+        CACHE_ALIGNED CAdaptiveSpin spin_;
+        CSyncMetrics metrics_;
+        //Read by every push
+        CACHE_ALIGNED CSyncListeners listeners_;
+#ifdef SYNC_CONTAINER_COROUTINES
+        //Last member, detaches from listeners_ before it is destroyed
+        CSyncAwaiters<CSyncContainer, value_type> awaiters_;
+#endif
 
+        bool isFull() const;
+        //Both return whether a thread sleeping on the other side has to be notified
+        template <class... Args>
+        bool emplaceLocked(Args&&... args);
+        bool popLocked(value_type& item);
+        template <class U>
+        bool pushOrSleepItem(U&& item);
+        template <class U>
+        bool tryPushItem(U&& item);
+        template <class U, class Clock, class Duration>
+        bool pushUntilItem(U&& item, const std::chrono::time_point<Clock, Duration>& deadline);
 };
 
 
 
-template <class CONTAINER>
-CSyncContainer<CONTAINER>::CSyncContainer()
+template <class CONTAINER, class BACKEND, class Enable>
+CSyncContainer<CONTAINER, BACKEND, Enable>::CSyncContainer(size_t capacity):capacity_(capacity),
+    sleepingConsumers_(0), sleepingProducers_(0)
 {
     terminated_.store(false);
+    size_.store(0);
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+void CSyncContainer<CONTAINER, BACKEND, Enable>::push(const value_type& item)
+{
+    emplace(item);
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+void CSyncContainer<CONTAINER, BACKEND, Enable>::push(value_type&& item)
+{
+    emplace(std::move(item));
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+template <class... Args>
+void CSyncContainer<CONTAINER, BACKEND, Enable>::emplace(Args&&... args)
+{
+    std::unique_lock<std::mutex> lock(containerLock_);
+    bool wake = emplaceLocked(std::forward<Args>(args)...);
+    lock.unlock();
+    if(wake)
+        notEmptyFlag_.notify_one();
+    listeners_.notify();
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::pushOrSleep(const value_type& item)
+{
+    return pushOrSleepItem(item);
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::pushOrSleep(value_type&& item)
+{
+    return pushOrSleepItem(std::move(item));
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::tryPush(const value_type& item)
+{
+    return tryPushItem(item);
 }
 
-template <class CONTAINER>
-void CSyncContainer<CONTAINER>::push(value_type item)
+template <class CONTAINER, class BACKEND, class Enable>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::tryPush(value_type&& item)
+{
+    return tryPushItem(std::move(item));
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+template <class Rep, class Period>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::pushFor(const value_type& item, const std::chrono::duration<Rep, Period>& timeout)
+{
+    return pushUntilItem(item, std::chrono::steady_clock::now() + timeout);
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+template <class Rep, class Period>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::pushFor(value_type&& item, const std::chrono::duration<Rep, Period>& timeout)
+{
+    return pushUntilItem(std::move(item), std::chrono::steady_clock::now() + timeout);
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+template <class U>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::pushOrSleepItem(U&& item)
 {
     std::unique_lock<std::mutex> lock(containerLock_);
-    //container_.push_back(item);
-    this->pushToContainer<CONTAINER>(container_, item);
+    while(isFull() && !terminated_)
+    {
+        ++sleepingProducers_;
+        notFullFlag_.wait(lock);
+        --sleepingProducers_;
+    }
+    if(isFull())
+        return false;
+    bool wake = emplaceLocked(std::forward<U>(item));
     lock.unlock();
-    notEmptyFlag_.notify_one();
+    if(wake)
+        notEmptyFlag_.notify_one();
+    listeners_.notify();
+    return true;
 }
 
-template <class CONTAINER>
-bool CSyncContainer<CONTAINER>::popOrSleep(value_type& item)
+template <class CONTAINER, class BACKEND, class Enable>
+template <class U>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::tryPushItem(U&& item)
 {
+    std::unique_lock<std::mutex> lock(containerLock_);
+    if(isFull())
+        return false;
+    bool wake = emplaceLocked(std::forward<U>(item));
+    lock.unlock();
+    if(wake)
+        notEmptyFlag_.notify_one();
+    listeners_.notify();
+    return true;
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+template <class U, class Clock, class Duration>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::pushUntilItem(U&& item, const std::chrono::time_point<Clock, Duration>& deadline)
+{
+    std::unique_lock<std::mutex> lock(containerLock_);
+    while(isFull() && !terminated_)
+    {
+        ++sleepingProducers_;
+        bool timedOut = notFullFlag_.wait_until(lock, deadline) == std::cv_status::timeout;
+        --sleepingProducers_;
+        if(timedOut)
+            break;
+    }
+    if(isFull())
+        return false;
+    bool wake = emplaceLocked(std::forward<U>(item));
+    lock.unlock();
+    if(wake)
+        notEmptyFlag_.notify_one();
+    listeners_.notify();
+    return true;
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::popOrSleep(value_type& item)
+{
+    //The next item usually arrives within microseconds, polling without the lock is cheaper than a futex round trip
+    spin_.spinUntil([this](){
+        return size_.load(std::memory_order_relaxed) != 0 || terminated_.load(std::memory_order_relaxed);
+    });
     std::unique_lock<std::mutex> lock(containerLock_);
     while(container_.empty() && !terminated_)
+    {
+        ++sleepingConsumers_;
+        auto sleep = metrics_.sleepBegin();
         notEmptyFlag_.wait(lock);
+        metrics_.sleepEnd(sleep);
+        --sleepingConsumers_;
+    }
     if(container_.empty())
         return false;
-    this->popFromContainer(container_, item);
+    bool wake = popLocked(item);
+    lock.unlock();
+    if(wake)
+        notFullFlag_.notify_one();
     return true;
 }
 
-template <class CONTAINER>
-bool CSyncContainer<CONTAINER>::popNoSleep(value_type& item)
+template <class CONTAINER, class BACKEND, class Enable>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::popNoSleep(value_type& item)
 {
     std::unique_lock<std::mutex> lock(containerLock_);
     if(container_.empty())
         return false;
-    this->popFromContainer(container_, item);
+    bool wake = popLocked(item);
+    lock.unlock();
+    if(wake)
+        notFullFlag_.notify_one();
     return true;
 }
-template <class CONTAINER>
-size_t CSyncContainer<CONTAINER>::size()
+template <class CONTAINER, class BACKEND, class Enable>
+template <class Rep, class Period>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::popFor(value_type& item, const std::chrono::duration<Rep, Period>& timeout)
+{
+    return popUntil(item, std::chrono::steady_clock::now() + timeout);
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+template <class Clock, class Duration>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::popUntil(value_type& item, const std::chrono::time_point<Clock, Duration>& deadline)
 {
     std::unique_lock<std::mutex> lock(containerLock_);
-    return container_.size();
+    while(container_.empty() && !terminated_)
+    {
+        //wait_until may return early on a spurious wakeup, only the timeout status ends the wait
+        ++sleepingConsumers_;
+        auto sleep = metrics_.sleepBegin();
+        bool timedOut = notEmptyFlag_.wait_until(lock, deadline) == std::cv_status::timeout;
+        metrics_.sleepEnd(sleep);
+        --sleepingConsumers_;
+        if(timedOut)
+            break;
+    }
+    if(container_.empty())
+        return false;
+    bool wake = popLocked(item);
+    lock.unlock();
+    if(wake)
+        notFullFlag_.notify_one();
+    return true;
+}
+
+template <class CONTAINER, class BACKEND, class Enable>
+size_t CSyncContainer<CONTAINER, BACKEND, Enable>::size()
+{
+    return size_.load(std::memory_order_relaxed);
 }
-template <class CONTAINER>
-void CSyncContainer<CONTAINER>::terminate()
+template <class CONTAINER, class BACKEND, class Enable>
+size_t CSyncContainer<CONTAINER, BACKEND, Enable>::capacity() const
+{
+    return capacity_;
+}
+template <class CONTAINER, class BACKEND, class Enable>
+CSyncMetricsSnapshot CSyncContainer<CONTAINER, BACKEND, Enable>::metrics() const
+{
+    return metrics_.snapshot(size_.load(std::memory_order_relaxed));
+}
+template <class CONTAINER, class BACKEND, class Enable>
+void CSyncContainer<CONTAINER, BACKEND, Enable>::terminate()
 {
     std::unique_lock<std::mutex> lock(containerLock_);
     terminated_.store(true);
     lock.unlock();
     notEmptyFlag_.notify_all();
+    notFullFlag_.notify_all();
+    listeners_.notify(true);
 }
-template <class CONTAINER>
-void CSyncContainer<CONTAINER>::restart()
+template <class CONTAINER, class BACKEND, class Enable>
+void CSyncContainer<CONTAINER, BACKEND, Enable>::restart()
 {
     std::unique_lock<std::mutex> lock(containerLock_);
     terminated_.store(false);
 }
-template <class CONTAINER>
-template <typename T>
-typename std::enable_if<
-              std::is_same<std::queue<typename CONTAINER::value_type>, T>::value ||
-              std::is_same<std::stack<typename CONTAINER::value_type>, T>::value>::type
-CSyncContainer<CONTAINER>::pushToContainer(T& container, value_type item)
+template <class CONTAINER, class BACKEND, class Enable>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::isFull() const
 {
-    container.push(item);
+    return capacity_ != 0 && container_.size() >= capacity_;
 }
-
-template <class CONTAINER>
-template <typename T>
-typename std::enable_if<
-              !(std::is_same<std::queue<typename CONTAINER::value_type>, T>::value ||
-              std::is_same<std::stack<typename CONTAINER::value_type>, T>::value)>::type
-CSyncContainer<CONTAINER>::popFromContainer(T& container, value_type& item)
+template <class CONTAINER, class BACKEND, class Enable>
+void CSyncContainer<CONTAINER, BACKEND, Enable>::setMaxSpin(std::chrono::nanoseconds maxSpin)
 {
-    item = container.back();
-    container.pop_back();
+    spin_.setMaxSpin(maxSpin);
 }
-
-template <class CONTAINER>
-template <class T>
-typename std::enable_if<
-              !(std::is_same<std::queue<typename CONTAINER::value_type>, T>::value ||
-              std::is_same<std::stack<typename CONTAINER::value_type>, T>::value)>::type
-CSyncContainer<CONTAINER>::pushToContainer(T& container,
-                                                value_type item)
+template <class CONTAINER, class BACKEND, class Enable>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::isTerminated() const
 {
-    container.push_back(item);
+    return terminated_.load();
 }
-
-template <class CONTAINER>
-template <typename T>
-typename std::enable_if<
-              std::is_same<std::queue<typename CONTAINER::value_type>, T>::value>::type
-CSyncContainer<CONTAINER>::popFromContainer(T& container, value_type& item)
+template <class CONTAINER, class BACKEND, class Enable>
+void CSyncContainer<CONTAINER, BACKEND, Enable>::attach(ISyncListener* listener)
 {
-    item = container.front();
-    container.pop();
+    listeners_.attach(listener);
 }
-
-template <class CONTAINER>
-template <typename T>
-typename std::enable_if<
-              std::is_same<std::stack<typename CONTAINER::value_type>, T>::value>::type
-CSyncContainer<CONTAINER>::popFromContainer(T& container, value_type& item)
+template <class CONTAINER, class BACKEND, class Enable>
+void CSyncContainer<CONTAINER, BACKEND, Enable>::detach(ISyncListener* listener)
+{
+    listeners_.detach(listener);
+}
+template <class CONTAINER, class BACKEND, class Enable>
+void CSyncContainer<CONTAINER, BACKEND, Enable>::arm()
 {
-    item = container.top();
-    container.pop();
+    listeners_.arm();
 }
+template <class CONTAINER, class BACKEND, class Enable>
+void CSyncContainer<CONTAINER, BACKEND, Enable>::disarm()
+{
+    listeners_.disarm();
+}
+#ifdef SYNC_CONTAINER_COROUTINES
+template <class CONTAINER, class BACKEND, class Enable>
+CPopAwaiter<CSyncContainer<CONTAINER, BACKEND, Enable>, typename CONTAINER::value_type>
+CSyncContainer<CONTAINER, BACKEND, Enable>::pop(ISyncExecutor& executor)
+{
+    return awaiters_.pop(*this, executor);
+}
+#endif
+template <class CONTAINER, class BACKEND, class Enable>
+template <class... Args>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::emplaceLocked(Args&&... args)
+{
+    CContainerTraits<CONTAINER>::emplace(container_, std::forward<Args>(args)...);
+    size_.store(container_.size(), std::memory_order_relaxed);
+    metrics_.pushed(container_.size());
+    spin_.recordArrival();
+    return sleepingConsumers_ != 0;
+}
+template <class CONTAINER, class BACKEND, class Enable>
+bool CSyncContainer<CONTAINER, BACKEND, Enable>::popLocked(value_type& item)
+{
+    CContainerTraits<CONTAINER>::pop(container_, item);
+    size_.store(container_.size(), std::memory_order_relaxed);
+    metrics_.popped(item);
+    return sleepingProducers_ != 0;
+}
+
+#include "CSyncContainerQueue.hpp"
 
 #endif
@@ -0,0 +1,410 @@
+#ifndef C_SYNC_CONTAINER_EVENT_COUNT
+#define C_SYNC_CONTAINER_EVENT_COUNT
+
+#include "CSyncContainer.hpp"
+#include "CEventCount.hpp"
+
+//Maps CONTAINER under a non-locking BACKEND to a concurrent structure with
+//void Push(value_type) and bool Pop(value_type&). Specializations define
+//type and enable (void), the empty primary keeps other combinations on the primary CSyncContainer.
+template <class CONTAINER, class BACKEND>
+struct CBackendStructure
+{
+};
+
+//CSyncContainer for backends whose structure synchronizes itself (CBackendStructure above).
+//Push and pop go straight to the structure, blocking is done with eventcounts,
+//so a mutex is only touched by threads that actually go to sleep and by whoever wakes them.
+//size_ counts an item from the moment its producer reserves room until a consumer takes it.
+template <class CONTAINER, class BACKEND>
+class CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>
+{
+    typedef typename CONTAINER::value_type value_type;
+    public:
+        //capacity == 0 means unbounded
+        explicit CSyncContainer(size_t capacity = 0);
+
+        //push ignores capacity, bounded producers should use pushOrSleep/tryPush/pushFor
+        void push(const value_type& item);
+        void push(value_type&& item);
+        template <class... Args>
+        void emplace(Args&&... args);
+        //Rvalue overloads leave item untouched when they return false
+        bool pushOrSleep(const value_type& item);
+        bool pushOrSleep(value_type&& item);
+        bool tryPush(const value_type& item);
+        bool tryPush(value_type&& item);
+        template <class Rep, class Period>
+        bool pushFor(const value_type& item, const std::chrono::duration<Rep, Period>& timeout);
+        template <class Rep, class Period>
+        bool pushFor(value_type&& item, const std::chrono::duration<Rep, Period>& timeout);
+        //Pops move the element out of the container into item
+        bool popOrSleep(value_type& item);
+        bool popNoSleep(value_type& item);
+        template <class Rep, class Period>
+        bool popFor(value_type& item, const std::chrono::duration<Rep, Period>& timeout);
+        template <class Clock, class Duration>
+        bool popUntil(value_type& item, const std::chrono::time_point<Clock, Duration>& deadline);
+        size_t size();
+        size_t capacity() const;
+        //Counters from CSyncMetrics.hpp, read without taking any lock. Only depth is filled
+        //unless SYNC_CONTAINER_METRICS is defined
+        CSyncMetricsSnapshot metrics() const;
+        void terminate();
+        void restart();
+        //Upper bound for the spin phase of popOrSleep, 0 makes consumers sleep right away
+        void setMaxSpin(std::chrono::nanoseconds maxSpin);
+        bool isTerminated() const;
+        //Armed listeners are told about pushes and termination, see CSyncSelector
+        void attach(ISyncListener* listener);
+        void detach(ISyncListener* listener);
+        //Listeners arm before their last check for an item and disarm after waking
+        void arm();
+        void disarm();
+#ifdef SYNC_CONTAINER_COROUTINES
+        //co_await pop(executor) suspends without blocking a thread, see CSyncAwait.hpp
+        CPopAwaiter<CSyncContainer, value_type> pop(ISyncExecutor& executor);
+#endif
+
+    private:
+        typename CBackendStructure<CONTAINER, BACKEND>::type structure_;
+        const size_t capacity_;
+        //Changed by every push and pop
+        CACHE_ALIGNED std::atomic<size_t> size_;
+        CACHE_ALIGNED std::atomic<bool> terminated_;
+        //Consumers announce themselves in notEmpty_, producers in notFull_
+        CACHE_ALIGNED CEventCount notEmpty_;
+        CACHE_ALIGNED CEventCount notFull_;
+        CACHE_ALIGNED CAdaptiveSpin spin_;
+        CSyncMetrics metrics_;
+        CACHE_ALIGNED CSyncListeners listeners_;
+#ifdef SYNC_CONTAINER_COROUTINES
+        //Last member, detaches from listeners_ before it is destroyed
+        CSyncAwaiters<CSyncContainer, value_type> awaiters_;
+#endif
+
+        CSyncContainer(const CSyncContainer& container) = delete;
+
+        bool reserve();
+        void publish(value_type&& item);
+        bool tryPop(value_type& item);
+        template <class U>
+        bool pushOrSleepItem(U&& item);
+        template <class U>
+        bool tryPushItem(U&& item);
+        template <class U, class Clock, class Duration>
+        bool pushUntilItem(U&& item, const std::chrono::time_point<Clock, Duration>& deadline);
+};
+
+
+
+template <class CONTAINER, class BACKEND>
+CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::CSyncContainer(size_t capacity):capacity_(capacity)
+{
+    size_.store(0);
+    terminated_.store(false);
+}
+
+template <class CONTAINER, class BACKEND>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::push(const value_type& item)
+{
+    size_.fetch_add(1);
+    publish(value_type(item));
+}
+
+template <class CONTAINER, class BACKEND>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::push(value_type&& item)
+{
+    size_.fetch_add(1);
+    publish(std::move(item));
+}
+
+template <class CONTAINER, class BACKEND>
+template <class... Args>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::emplace(Args&&... args)
+{
+    size_.fetch_add(1);
+    publish(value_type(std::forward<Args>(args)...));
+}
+
+template <class CONTAINER, class BACKEND>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::pushOrSleep(const value_type& item)
+{
+    return pushOrSleepItem(item);
+}
+
+template <class CONTAINER, class BACKEND>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::pushOrSleep(value_type&& item)
+{
+    return pushOrSleepItem(std::move(item));
+}
+
+template <class CONTAINER, class BACKEND>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::tryPush(const value_type& item)
+{
+    return tryPushItem(item);
+}
+
+template <class CONTAINER, class BACKEND>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::tryPush(value_type&& item)
+{
+    return tryPushItem(std::move(item));
+}
+
+template <class CONTAINER, class BACKEND>
+template <class Rep, class Period>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::pushFor(const value_type& item, const std::chrono::duration<Rep, Period>& timeout)
+{
+    return pushUntilItem(item, std::chrono::steady_clock::now() + timeout);
+}
+
+template <class CONTAINER, class BACKEND>
+template <class Rep, class Period>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::pushFor(value_type&& item, const std::chrono::duration<Rep, Period>& timeout)
+{
+    return pushUntilItem(std::move(item), std::chrono::steady_clock::now() + timeout);
+}
+
+template <class CONTAINER, class BACKEND>
+template <class U>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::pushOrSleepItem(U&& item)
+{
+    while(!reserve())
+    {
+        if(terminated_)
+            return false;
+        auto key = notFull_.prepareWait();
+        if(reserve())
+        {
+            notFull_.cancelWait();
+            break;
+        }
+        if(terminated_)
+        {
+            notFull_.cancelWait();
+            return false;
+        }
+        notFull_.wait(key);
+    }
+    publish(value_type(std::forward<U>(item)));
+    return true;
+}
+
+template <class CONTAINER, class BACKEND>
+template <class U>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::tryPushItem(U&& item)
+{
+    if(!reserve())
+        return false;
+    publish(value_type(std::forward<U>(item)));
+    return true;
+}
+
+template <class CONTAINER, class BACKEND>
+template <class U, class Clock, class Duration>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::pushUntilItem(U&& item, const std::chrono::time_point<Clock, Duration>& deadline)
+{
+    while(!reserve())
+    {
+        if(terminated_)
+            return false;
+        auto key = notFull_.prepareWait();
+        if(reserve())
+        {
+            notFull_.cancelWait();
+            break;
+        }
+        if(terminated_)
+        {
+            notFull_.cancelWait();
+            return false;
+        }
+        if(!notFull_.waitUntil(key, deadline))
+        {
+            if(!reserve())
+                return false;
+            break;
+        }
+    }
+    publish(value_type(std::forward<U>(item)));
+    return true;
+}
+
+template <class CONTAINER, class BACKEND>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::popOrSleep(value_type& item)
+{
+    spin_.spinUntil([this](){
+        return size_.load(std::memory_order_relaxed) != 0 || terminated_.load(std::memory_order_relaxed);
+    });
+    while(!tryPop(item))
+    {
+        auto key = notEmpty_.prepareWait();
+        if(tryPop(item))
+        {
+            notEmpty_.cancelWait();
+            return true;
+        }
+        if(terminated_)
+        {
+            notEmpty_.cancelWait();
+            return false;
+        }
+        auto sleep = metrics_.sleepBegin();
+        notEmpty_.wait(key);
+        metrics_.sleepEnd(sleep);
+    }
+    return true;
+}
+
+template <class CONTAINER, class BACKEND>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::popNoSleep(value_type& item)
+{
+    return tryPop(item);
+}
+
+template <class CONTAINER, class BACKEND>
+template <class Rep, class Period>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::popFor(value_type& item, const std::chrono::duration<Rep, Period>& timeout)
+{
+    return popUntil(item, std::chrono::steady_clock::now() + timeout);
+}
+
+template <class CONTAINER, class BACKEND>
+template <class Clock, class Duration>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::popUntil(value_type& item, const std::chrono::time_point<Clock, Duration>& deadline)
+{
+    while(!tryPop(item))
+    {
+        auto key = notEmpty_.prepareWait();
+        if(tryPop(item))
+        {
+            notEmpty_.cancelWait();
+            return true;
+        }
+        if(terminated_)
+        {
+            notEmpty_.cancelWait();
+            return false;
+        }
+        auto sleep = metrics_.sleepBegin();
+        bool woken = notEmpty_.waitUntil(key, deadline);
+        metrics_.sleepEnd(sleep);
+        if(!woken)
+            return tryPop(item);
+    }
+    return true;
+}
+
+template <class CONTAINER, class BACKEND>
+size_t CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::size()
+{
+    return size_.load();
+}
+
+template <class CONTAINER, class BACKEND>
+size_t CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::capacity() const
+{
+    return capacity_;
+}
+
+template <class CONTAINER, class BACKEND>
+CSyncMetricsSnapshot CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::metrics() const
+{
+    return metrics_.snapshot(size_.load(std::memory_order_relaxed));
+}
+
+template <class CONTAINER, class BACKEND>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::terminate()
+{
+    terminated_.store(true);
+    notEmpty_.notifyAll();
+    notFull_.notifyAll();
+    listeners_.notify(true);
+}
+
+template <class CONTAINER, class BACKEND>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::restart()
+{
+    terminated_.store(false);
+}
+
+template <class CONTAINER, class BACKEND>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::setMaxSpin(std::chrono::nanoseconds maxSpin)
+{
+    spin_.setMaxSpin(maxSpin);
+}
+
+template <class CONTAINER, class BACKEND>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::isTerminated() const
+{
+    return terminated_.load();
+}
+
+template <class CONTAINER, class BACKEND>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::attach(ISyncListener* listener)
+{
+    listeners_.attach(listener);
+}
+
+template <class CONTAINER, class BACKEND>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::detach(ISyncListener* listener)
+{
+    listeners_.detach(listener);
+}
+
+template <class CONTAINER, class BACKEND>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::arm()
+{
+    listeners_.arm();
+}
+
+template <class CONTAINER, class BACKEND>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::disarm()
+{
+    listeners_.disarm();
+}
+
+#ifdef SYNC_CONTAINER_COROUTINES
+template <class CONTAINER, class BACKEND>
+CPopAwaiter<CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>, typename CONTAINER::value_type>
+CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::pop(ISyncExecutor& executor)
+{
+    return awaiters_.pop(*this, executor);
+}
+#endif
+
+template <class CONTAINER, class BACKEND>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::reserve()
+{
+    size_t size = size_.load(std::memory_order_relaxed);
+    do{
+        if(capacity_ != 0 && size >= capacity_)
+            return false;
+    }while(!size_.compare_exchange_weak(size, size + 1));
+    return true;
+}
+
+template <class CONTAINER, class BACKEND>
+void CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::publish(value_type&& item)
+{
+    structure_.Push(std::move(item));
+    metrics_.pushed(size_.load(std::memory_order_relaxed));
+    spin_.recordArrival();
+    notEmpty_.notify();
+    listeners_.notify();
+}
+
+template <class CONTAINER, class BACKEND>
+bool CSyncContainer<CONTAINER, BACKEND, typename CBackendStructure<CONTAINER, BACKEND>::enable>::tryPop(value_type& item)
+{
+    if(!structure_.Pop(item))
+        return false;
+    size_.fetch_sub(1);
+    metrics_.popped(item);
+    //Unbounded producers never wait on notFull_
+    if(capacity_ != 0)
+        notFull_.notify();
+    return true;
+}
+
+#endif
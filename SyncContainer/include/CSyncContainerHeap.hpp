@@ -0,0 +1,16 @@
+#ifndef C_SYNC_CONTAINER_HEAP
+#define C_SYNC_CONTAINER_HEAP
+
+#include "CSyncContainerEventCount.hpp"
+#include "CConcurrentHeap.hpp"
+
+//CSyncContainer<std::priority_queue<T, SEQUENCE, COMPARE>, CFineGrainedBackend> keeps the
+//priority_queue order without a container-wide lock
+template <class T, class SEQUENCE, class COMPARE>
+struct CBackendStructure<std::priority_queue<T, SEQUENCE, COMPARE>, CFineGrainedBackend>
+{
+    typedef CConcurrentHeap<T, COMPARE> type;
+    typedef void enable;
+};
+
+#endif
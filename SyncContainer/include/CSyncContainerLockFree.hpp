@@ -0,0 +1,22 @@
+#ifndef C_SYNC_CONTAINER_LOCK_FREE
+#define C_SYNC_CONTAINER_LOCK_FREE
+
+#include "CSyncContainerEventCount.hpp"
+#include <LockFreeQueue.hpp>
+#include <LockFreeStack.hpp>
+
+template <class T>
+struct CBackendStructure<std::queue<T>, CLockFreeBackend>
+{
+    typedef LockFreeQueue<T> type;
+    typedef void enable;
+};
+
+template <class T>
+struct CBackendStructure<std::stack<T>, CLockFreeBackend>
+{
+    typedef LockFreeStack<T> type;
+    typedef void enable;
+};
+
+#endif
@@ -0,0 +1,537 @@
+#ifndef C_SYNC_CONTAINER_QUEUE
+#define C_SYNC_CONTAINER_QUEUE
+
+#include "CSyncContainer.hpp"
+
+//Two-lock FIFO (Michael & Scott) used for CSyncContainer<std::queue<T>>.
+//Producers only touch tail_ under tailLock_, consumers only touch head_ under headLock_,
+//head_ always points to a sentinel node, so push and pop never contend on the same lock.
+template <class CONTAINER>
+class CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>
+{
+    typedef typename CONTAINER::value_type value_type;
+    public:
+        //capacity == 0 means unbounded
+        explicit CSyncContainer(size_t capacity = 0);
+        ~CSyncContainer();
+
+        //push ignores capacity, bounded producers should use pushOrSleep/tryPush/pushFor
+        void push(const value_type& item);
+        void push(value_type&& item);
+        template <class... Args>
+        void emplace(Args&&... args);
+        //Rvalue overloads leave item untouched when they return false
+        bool pushOrSleep(const value_type& item);
+        bool pushOrSleep(value_type&& item);
+        bool tryPush(const value_type& item);
+        bool tryPush(value_type&& item);
+        template <class Rep, class Period>
+        bool pushFor(const value_type& item, const std::chrono::duration<Rep, Period>& timeout);
+        template <class Rep, class Period>
+        bool pushFor(value_type&& item, const std::chrono::duration<Rep, Period>& timeout);
+        //Pops move the element out of the queue into item
+        bool popOrSleep(value_type& item);
+        bool popNoSleep(value_type& item);
+        template <class Rep, class Period>
+        bool popFor(value_type& item, const std::chrono::duration<Rep, Period>& timeout);
+        template <class Clock, class Duration>
+        bool popUntil(value_type& item, const std::chrono::time_point<Clock, Duration>& deadline);
+        size_t size();
+        size_t capacity() const;
+        //Counters from CSyncMetrics.hpp, read without taking any lock. Only depth is filled
+        //unless SYNC_CONTAINER_METRICS is defined
+        CSyncMetricsSnapshot metrics() const;
+        void terminate();
+        void restart();
+        //Upper bound for the spin phase of popOrSleep, 0 makes consumers sleep right away
+        void setMaxSpin(std::chrono::nanoseconds maxSpin);
+        bool isTerminated() const;
+        //Armed listeners are told about pushes and termination, see CSyncSelector
+        void attach(ISyncListener* listener);
+        void detach(ISyncListener* listener);
+        //Listeners arm before their last check for an item and disarm after waking
+        void arm();
+        void disarm();
+#ifdef SYNC_CONTAINER_COROUTINES
+        //co_await pop(executor) suspends without blocking a thread, see CSyncAwait.hpp
+        CPopAwaiter<CSyncContainer, value_type> pop(ISyncExecutor& executor);
+#endif
+
+    private:
+        struct Node
+        {
+            template <class... Args>
+            explicit Node(Args&&... args):next(nullptr), data(std::forward<Args>(args)...) {}
+            std::atomic<Node*> next;
+            value_type data;
+        };
+
+        //Consumers and producers each keep to their own lines
+        CACHE_ALIGNED std::mutex headLock_;
+        Node* head_;
+        std::condition_variable notEmptyFlag_;
+        CACHE_ALIGNED std::mutex tailLock_;
+        Node* tail_;
+        std::condition_variable notFullFlag_;
+        //Read by the other side on every operation, written only around sleeps and on terminate
+        CACHE_ALIGNED std::atomic<int> sleepingConsumers_;
+        std::atomic<int> sleepingProducers_;
+        std::atomic<bool> terminated_;
+        const size_t capacity_;
+        //Counted before a node is linked and after it is unlinked, so it never underflows
+        CACHE_ALIGNED std::atomic<size_t> size_;
+        CACHE_ALIGNED CAdaptiveSpin spin_;
+        CSyncMetrics metrics_;
+        CACHE_ALIGNED CSyncListeners listeners_;
+#ifdef SYNC_CONTAINER_COROUTINES
+        //Last member, detaches from listeners_ before it is destroyed
+        CSyncAwaiters<CSyncContainer, value_type> awaiters_;
+#endif
+
+        CSyncContainer(const CSyncContainer& container) = delete;
+
+        bool isEmpty() const;
+        bool isFull() const;
+        void enqueue(Node* node);
+        void dequeue(value_type& item);
+        void notifyNotEmpty();
+        void notifyNotFull();
+        template <class U>
+        bool pushOrSleepItem(U&& item);
+        template <class U>
+        bool tryPushItem(U&& item);
+        template <class U, class Clock, class Duration>
+        bool pushUntilItem(U&& item, const std::chrono::time_point<Clock, Duration>& deadline);
+};
+
+
+
+template <class CONTAINER>
+CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                 std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+CSyncContainer(size_t capacity):capacity_(capacity)
+{
+    head_ = tail_ = new Node();
+    size_.store(0);
+    sleepingConsumers_.store(0);
+    sleepingProducers_.store(0);
+    terminated_.store(false);
+}
+
+template <class CONTAINER>
+CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                 std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+~CSyncContainer()
+{
+    while(head_ != nullptr)
+    {
+        Node* next = head_->next.load();
+        delete head_;
+        head_ = next;
+    }
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+push(const value_type& item)
+{
+    emplace(item);
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+push(value_type&& item)
+{
+    emplace(std::move(item));
+}
+
+template <class CONTAINER>
+template <class... Args>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+emplace(Args&&... args)
+{
+    Node* node = new Node(std::forward<Args>(args)...);
+    std::unique_lock<std::mutex> lock(tailLock_);
+    enqueue(node);
+    lock.unlock();
+    notifyNotEmpty();
+}
+
+template <class CONTAINER>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+pushOrSleep(const value_type& item)
+{
+    return pushOrSleepItem(item);
+}
+
+template <class CONTAINER>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+pushOrSleep(value_type&& item)
+{
+    return pushOrSleepItem(std::move(item));
+}
+
+template <class CONTAINER>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+tryPush(const value_type& item)
+{
+    return tryPushItem(item);
+}
+
+template <class CONTAINER>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+tryPush(value_type&& item)
+{
+    return tryPushItem(std::move(item));
+}
+
+template <class CONTAINER>
+template <class Rep, class Period>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+pushFor(const value_type& item, const std::chrono::duration<Rep, Period>& timeout)
+{
+    return pushUntilItem(item, std::chrono::steady_clock::now() + timeout);
+}
+
+template <class CONTAINER>
+template <class Rep, class Period>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+pushFor(value_type&& item, const std::chrono::duration<Rep, Period>& timeout)
+{
+    return pushUntilItem(std::move(item), std::chrono::steady_clock::now() + timeout);
+}
+
+template <class CONTAINER>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+popOrSleep(value_type& item)
+{
+    spin_.spinUntil([this](){
+        return size_.load(std::memory_order_relaxed) != 0 || terminated_.load(std::memory_order_relaxed);
+    });
+    std::unique_lock<std::mutex> lock(headLock_);
+    while(isEmpty() && !terminated_)
+    {
+        ++sleepingConsumers_;
+        if(isEmpty() && !terminated_)
+        {
+            auto sleep = metrics_.sleepBegin();
+            notEmptyFlag_.wait(lock);
+            metrics_.sleepEnd(sleep);
+        }
+        --sleepingConsumers_;
+    }
+    if(isEmpty())
+        return false;
+    dequeue(item);
+    lock.unlock();
+    notifyNotFull();
+    return true;
+}
+
+template <class CONTAINER>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+popNoSleep(value_type& item)
+{
+    std::unique_lock<std::mutex> lock(headLock_);
+    if(isEmpty())
+        return false;
+    dequeue(item);
+    lock.unlock();
+    notifyNotFull();
+    return true;
+}
+
+template <class CONTAINER>
+template <class Rep, class Period>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+popFor(value_type& item, const std::chrono::duration<Rep, Period>& timeout)
+{
+    return popUntil(item, std::chrono::steady_clock::now() + timeout);
+}
+
+template <class CONTAINER>
+template <class Clock, class Duration>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+popUntil(value_type& item, const std::chrono::time_point<Clock, Duration>& deadline)
+{
+    std::unique_lock<std::mutex> lock(headLock_);
+    while(isEmpty() && !terminated_)
+    {
+        ++sleepingConsumers_;
+        bool timedOut = false;
+        if(isEmpty() && !terminated_)
+        {
+            auto sleep = metrics_.sleepBegin();
+            timedOut = notEmptyFlag_.wait_until(lock, deadline) == std::cv_status::timeout;
+            metrics_.sleepEnd(sleep);
+        }
+        --sleepingConsumers_;
+        if(timedOut)
+            break;
+    }
+    if(isEmpty())
+        return false;
+    dequeue(item);
+    lock.unlock();
+    notifyNotFull();
+    return true;
+}
+
+template <class CONTAINER>
+size_t CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                        std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+size()
+{
+    return size_.load();
+}
+
+template <class CONTAINER>
+size_t CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                        std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+capacity() const
+{
+    return capacity_;
+}
+
+template <class CONTAINER>
+CSyncMetricsSnapshot CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                        std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+metrics() const
+{
+    return metrics_.snapshot(size_.load(std::memory_order_relaxed));
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+terminate()
+{
+    std::unique_lock<std::mutex> headLock(headLock_, std::defer_lock);
+    std::unique_lock<std::mutex> tailLock(tailLock_, std::defer_lock);
+    std::lock(headLock, tailLock);
+    terminated_.store(true);
+    headLock.unlock();
+    tailLock.unlock();
+    notEmptyFlag_.notify_all();
+    notFullFlag_.notify_all();
+    listeners_.notify(true);
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+restart()
+{
+    std::unique_lock<std::mutex> headLock(headLock_, std::defer_lock);
+    std::unique_lock<std::mutex> tailLock(tailLock_, std::defer_lock);
+    std::lock(headLock, tailLock);
+    terminated_.store(false);
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+setMaxSpin(std::chrono::nanoseconds maxSpin)
+{
+    spin_.setMaxSpin(maxSpin);
+}
+
+template <class CONTAINER>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+isTerminated() const
+{
+    return terminated_.load();
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+attach(ISyncListener* listener)
+{
+    listeners_.attach(listener);
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+detach(ISyncListener* listener)
+{
+    listeners_.detach(listener);
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+arm()
+{
+    listeners_.arm();
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+disarm()
+{
+    listeners_.disarm();
+}
+
+#ifdef SYNC_CONTAINER_COROUTINES
+template <class CONTAINER>
+CPopAwaiter<CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>, typename CONTAINER::value_type>
+CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+pop(ISyncExecutor& executor)
+{
+    return awaiters_.pop(*this, executor);
+}
+#endif
+
+template <class CONTAINER>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+isEmpty() const
+{
+    return head_->next.load() == nullptr;
+}
+
+template <class CONTAINER>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+isFull() const
+{
+    return capacity_ != 0 && size_.load() >= capacity_;
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+enqueue(Node* node)
+{
+    metrics_.pushed(++size_);
+    tail_->next.store(node);
+    tail_ = node;
+    spin_.recordArrival();
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+dequeue(value_type& item)
+{
+    Node* sentinel = head_;
+    head_ = sentinel->next.load();
+    item = std::move(head_->data);
+    --size_;
+    metrics_.popped(item);
+    delete sentinel;
+}
+
+//The bounded pushes only build the node once there is room, so a failed push keeps the item
+template <class CONTAINER>
+template <class U>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+pushOrSleepItem(U&& item)
+{
+    std::unique_lock<std::mutex> lock(tailLock_);
+    while(isFull() && !terminated_)
+    {
+        ++sleepingProducers_;
+        if(isFull() && !terminated_)
+            notFullFlag_.wait(lock);
+        --sleepingProducers_;
+    }
+    if(isFull())
+        return false;
+    enqueue(new Node(std::forward<U>(item)));
+    lock.unlock();
+    notifyNotEmpty();
+    return true;
+}
+
+template <class CONTAINER>
+template <class U>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+tryPushItem(U&& item)
+{
+    std::unique_lock<std::mutex> lock(tailLock_);
+    if(isFull())
+        return false;
+    enqueue(new Node(std::forward<U>(item)));
+    lock.unlock();
+    notifyNotEmpty();
+    return true;
+}
+
+template <class CONTAINER>
+template <class U, class Clock, class Duration>
+bool CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+pushUntilItem(U&& item, const std::chrono::time_point<Clock, Duration>& deadline)
+{
+    std::unique_lock<std::mutex> lock(tailLock_);
+    while(isFull() && !terminated_)
+    {
+        ++sleepingProducers_;
+        bool timedOut = false;
+        if(isFull() && !terminated_)
+            timedOut = notFullFlag_.wait_until(lock, deadline) == std::cv_status::timeout;
+        --sleepingProducers_;
+        if(timedOut)
+            break;
+    }
+    if(isFull())
+        return false;
+    enqueue(new Node(std::forward<U>(item)));
+    lock.unlock();
+    notifyNotEmpty();
+    return true;
+}
+
+//Consumers register in sleepingConsumers_ before re-checking isEmpty() under headLock_,
+//so a producer that sees no sleepers is guaranteed that they will see its node.
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+notifyNotEmpty()
+{
+    listeners_.notify();
+    if(sleepingConsumers_.load() == 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(headLock_);
+    }
+    notEmptyFlag_.notify_one();
+}
+
+template <class CONTAINER>
+void CSyncContainer<CONTAINER, CLockingBackend, typename std::enable_if<
+                      std::is_same<std::queue<typename CONTAINER::value_type>, CONTAINER>::value>::type>::
+notifyNotFull()
+{
+    if(capacity_ == 0 || sleepingProducers_.load() == 0)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(tailLock_);
+    }
+    notFullFlag_.notify_one();
+}
+
+#endif
@@ -0,0 +1,79 @@
+#ifndef C_SYNC_EXECUTOR
+#define C_SYNC_EXECUTOR
+
+#include "CSyncContainer.hpp"
+#include "CpuTopology.hpp"
+
+#ifdef SYNC_CONTAINER_COROUTINES
+
+#include <thread>
+#include <vector>
+
+//Runs resumed coroutines on a fixed set of threads, so any number of awaiting consumers share
+//a handful of OS threads. Handles go through a two-lock CSyncContainer queue.
+//The destructor resumes whatever is still queued before joining.
+//Given a CpuTopology policy each worker pins itself to the CPU the placement assigns it.
+class CThreadPoolExecutor: public ISyncExecutor
+{
+    public:
+        explicit CThreadPoolExecutor(size_t threads = std::thread::hardware_concurrency());
+        CThreadPoolExecutor(size_t threads, CpuTopology::Policy policy,
+                            const CpuTopology& topology = CpuTopology::instance());
+        ~CThreadPoolExecutor();
+
+        void resume(std::coroutine_handle<> handle);
+        size_t threads() const;
+
+    private:
+        CSyncContainer<std::queue<std::coroutine_handle<>>> ready_;
+        std::vector<std::thread> workers_;
+
+        CThreadPoolExecutor(const CThreadPoolExecutor& executor) = delete;
+        void work();
+};
+
+
+
+inline CThreadPoolExecutor::CThreadPoolExecutor(size_t threads)
+{
+    for(size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+        workers_.emplace_back([this](){ work(); });
+}
+
+inline CThreadPoolExecutor::CThreadPoolExecutor(size_t threads, CpuTopology::Policy policy,
+                                                const CpuTopology& topology)
+{
+    for(int cpu: topology.placement(policy, std::max<size_t>(threads, 1)))
+        workers_.emplace_back([this, cpu](){
+            CpuTopology::pinCurrentThread(cpu);
+            work();
+        });
+}
+
+inline CThreadPoolExecutor::~CThreadPoolExecutor()
+{
+    ready_.terminate();
+    for(auto& worker: workers_)
+        worker.join();
+}
+
+inline void CThreadPoolExecutor::resume(std::coroutine_handle<> handle)
+{
+    ready_.push(handle);
+}
+
+inline size_t CThreadPoolExecutor::threads() const
+{
+    return workers_.size();
+}
+
+inline void CThreadPoolExecutor::work()
+{
+    std::coroutine_handle<> handle;
+    while(ready_.popOrSleep(handle))
+        handle.resume();
+}
+
+#endif
+
+#endif
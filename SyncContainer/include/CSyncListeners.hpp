@@ -0,0 +1,127 @@
+#ifndef C_SYNC_LISTENERS
+#define C_SYNC_LISTENERS
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Threads waiting on several containers at once (CSyncSelector) hear about pushes and termination
+//through this interface. notify runs on the producer's thread and must not block.
+class ISyncListener
+{
+    public:
+        virtual ~ISyncListener() {}
+        //all is set on termination, when every waiter has to re-check
+        virtual void notify(bool all) = 0;
+        //A waiter is about to sleep or asleep, notify is skipped otherwise
+        virtual bool armed() const = 0;
+};
+
+//Listener list embedded in every CSyncContainer. Containers call notify after an item has been
+//published. A listener arm()s the container before its last check for an item and disarm()s it
+//after waking, notify costs one load while nothing is armed, so attached but busy consumers do
+//not slow producers down.
+//Producers walk an immutable snapshot of the list without locking. attach and detach publish a
+//copy and wait for notifiers still inside the old one, counted in two halves flipped in turn as
+//in SRCU, so after detach returns the listener is not called again.
+class CSyncListeners
+{
+    public:
+        CSyncListeners();
+        ~CSyncListeners();
+
+        void attach(ISyncListener* listener);
+        void detach(ISyncListener* listener);
+        void arm();
+        void disarm();
+        void notify(bool all = false);
+
+    private:
+        typedef std::vector<ISyncListener*> List;
+
+        //Serializes attach and detach
+        std::mutex lock_;
+        std::atomic<const List*> list_;
+        //seq_cst: a producer that finds nothing armed published its item before the listener's last check
+        std::atomic<int> armed_;
+        std::atomic<unsigned int> phase_;
+        std::atomic<int> notifying_[2];
+
+        CSyncListeners(const CSyncListeners& listeners) = delete;
+
+        void replace(const List* list);
+};
+
+
+
+inline CSyncListeners::CSyncListeners()
+{
+    list_.store(new List());
+    armed_.store(0);
+    phase_.store(0);
+    notifying_[0].store(0);
+    notifying_[1].store(0);
+}
+
+inline CSyncListeners::~CSyncListeners()
+{
+    delete list_.load();
+}
+
+inline void CSyncListeners::attach(ISyncListener* listener)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    List* list = new List(*list_.load());
+    list->push_back(listener);
+    replace(list);
+}
+
+inline void CSyncListeners::detach(ISyncListener* listener)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    List* list = new List(*list_.load());
+    list->erase(std::remove(list->begin(), list->end(), listener), list->end());
+    replace(list);
+}
+
+inline void CSyncListeners::arm()
+{
+    armed_.fetch_add(1);
+}
+
+inline void CSyncListeners::disarm()
+{
+    armed_.fetch_sub(1);
+}
+
+inline void CSyncListeners::notify(bool all)
+{
+    if(armed_.load() == 0)
+        return;
+    std::atomic<int>& notifying = notifying_[phase_.load() & 1];
+    notifying.fetch_add(1);
+    for(auto listener: *list_.load())
+    {
+        if(listener->armed())
+            listener->notify(all);
+    }
+    notifying.fetch_sub(1, std::memory_order_release);
+}
+
+//Waits on both halves after publishing: a notifier missed by the wait on its half loaded the list
+//after the new one went in. The flip before each wait sends new notifiers to the other half.
+inline void CSyncListeners::replace(const List* list)
+{
+    const List* old = list_.exchange(list);
+    for(int flip = 0; flip < 2; ++flip)
+    {
+        unsigned int phase = phase_.fetch_add(1) & 1;
+        while(notifying_[phase].load() != 0)
+            std::this_thread::yield();
+    }
+    delete old;
+}
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef C_SYNC_METRICS
+#define C_SYNC_METRICS
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+
+//Wrap value_type in CTimestamped to have the container record how long every item waited.
+//The stamp is taken when the wrapper is constructed, so emplace or push of a plain value stamps it
+//at enqueue time, while copies keep the original stamp.
+template <class T>
+struct CTimestamped
+{
+    CTimestamped():value(), stamp(std::chrono::steady_clock::now()) {}
+    CTimestamped(const T& item):value(item), stamp(std::chrono::steady_clock::now()) {}
+    CTimestamped(T&& item):value(std::move(item)), stamp(std::chrono::steady_clock::now()) {}
+
+    T value;
+    std::chrono::steady_clock::time_point stamp;
+};
+
+//What CSyncContainer::metrics() returns. Counters are read one at a time while producers and
+//consumers keep running, so fields can disagree by the operations in flight.
+struct CSyncMetricsSnapshot
+{
+    static const int BUCKETS = 48;
+
+    CSyncMetricsSnapshot();
+
+    size_t depth;
+    size_t highWater;
+    uint64_t enqueued;
+    uint64_t dequeued;
+    //Times a consumer went to sleep on an empty container and how long it slept in total
+    uint64_t sleeps;
+    std::chrono::nanoseconds sleepTime;
+    //sojourn[i] counts CTimestamped items that waited less than 2^(i+1) ns and at least 2^i ns
+    std::array<uint64_t, BUCKETS> sojourn;
+
+    uint64_t sojournCount() const;
+    //Upper bound of the bucket holding the q-quantile, 0 when nothing was recorded
+    std::chrono::nanoseconds sojournQuantile(double q) const;
+};
+
+//Counters embedded in every CSyncContainer, built with SYNC_CONTAINER_METRICS only.
+//Every update is a relaxed atomic add, high-water is a CAS that only loops while depth grows past it.
+//Without SYNC_CONTAINER_METRICS all calls are empty inline functions and snapshot only carries depth.
+class CSyncMetrics
+{
+    public:
+#ifdef SYNC_CONTAINER_METRICS
+        typedef std::chrono::steady_clock::time_point Stamp;
+#else
+        struct Stamp {};
+#endif
+
+        CSyncMetrics();
+
+        void pushed(size_t depth);
+        template <class T>
+        void popped(const T& item);
+        template <class T>
+        void popped(const CTimestamped<T>& item);
+        Stamp sleepBegin();
+        void sleepEnd(const Stamp& begin);
+        void recordSojourn(std::chrono::nanoseconds sojourn);
+        CSyncMetricsSnapshot snapshot(size_t depth) const;
+
+#ifdef SYNC_CONTAINER_METRICS
+    private:
+        std::atomic<size_t> highWater_;
+        std::atomic<uint64_t> enqueued_;
+        std::atomic<uint64_t> dequeued_;
+        std::atomic<uint64_t> sleeps_;
+        std::atomic<int64_t> sleepTime_;
+        std::array<std::atomic<uint64_t>, CSyncMetricsSnapshot::BUCKETS> sojourn_;
+#endif
+};
+
+
+
+inline CSyncMetricsSnapshot::CSyncMetricsSnapshot():depth(0), highWater(0), enqueued(0), dequeued(0),
+    sleeps(0), sleepTime(0)
+{
+    sojourn.fill(0);
+}
+
+inline uint64_t CSyncMetricsSnapshot::sojournCount() const
+{
+    uint64_t count = 0;
+    for(auto bucket: sojourn)
+        count += bucket;
+    return count;
+}
+
+inline std::chrono::nanoseconds CSyncMetricsSnapshot::sojournQuantile(double q) const
+{
+    uint64_t count = sojournCount();
+    if(count == 0)
+        return std::chrono::nanoseconds(0);
+    uint64_t rank = uint64_t(q * count);
+    if(rank >= count)
+        rank = count - 1;
+    uint64_t seen = 0;
+    for(int i = 0; i < BUCKETS; ++i)
+    {
+        seen += sojourn[i];
+        if(seen > rank)
+            return std::chrono::nanoseconds(int64_t(1) << (i + 1));
+    }
+    return std::chrono::nanoseconds(int64_t(1) << BUCKETS);
+}
+
+#ifdef SYNC_CONTAINER_METRICS
+
+inline CSyncMetrics::CSyncMetrics()
+{
+    highWater_.store(0);
+    enqueued_.store(0);
+    dequeued_.store(0);
+    sleeps_.store(0);
+    sleepTime_.store(0);
+    for(auto& bucket: sojourn_)
+        bucket.store(0);
+}
+
+inline void CSyncMetrics::pushed(size_t depth)
+{
+    enqueued_.fetch_add(1, std::memory_order_relaxed);
+    size_t highWater = highWater_.load(std::memory_order_relaxed);
+    while(depth > highWater && !highWater_.compare_exchange_weak(highWater, depth, std::memory_order_relaxed));
+}
+
+template <class T>
+void CSyncMetrics::popped(const T& item)
+{
+    dequeued_.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class T>
+void CSyncMetrics::popped(const CTimestamped<T>& item)
+{
+    dequeued_.fetch_add(1, std::memory_order_relaxed);
+    recordSojourn(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - item.stamp));
+}
+
+inline CSyncMetrics::Stamp CSyncMetrics::sleepBegin()
+{
+    return std::chrono::steady_clock::now();
+}
+
+inline void CSyncMetrics::sleepEnd(const Stamp& begin)
+{
+    sleeps_.fetch_add(1, std::memory_order_relaxed);
+    sleepTime_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - begin).count(), std::memory_order_relaxed);
+}
+
+inline void CSyncMetrics::recordSojourn(std::chrono::nanoseconds sojourn)
+{
+    uint64_t ns = sojourn.count() > 1 ? uint64_t(sojourn.count()) : 1;
+    int bucket = 63 - __builtin_clzll(ns);
+    if(bucket >= CSyncMetricsSnapshot::BUCKETS)
+        bucket = CSyncMetricsSnapshot::BUCKETS - 1;
+    sojourn_[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+inline CSyncMetricsSnapshot CSyncMetrics::snapshot(size_t depth) const
+{
+    CSyncMetricsSnapshot snapshot;
+    snapshot.depth = depth;
+    snapshot.highWater = highWater_.load(std::memory_order_relaxed);
+    snapshot.enqueued = enqueued_.load(std::memory_order_relaxed);
+    snapshot.dequeued = dequeued_.load(std::memory_order_relaxed);
+    snapshot.sleeps = sleeps_.load(std::memory_order_relaxed);
+    snapshot.sleepTime = std::chrono::nanoseconds(sleepTime_.load(std::memory_order_relaxed));
+    for(int i = 0; i < CSyncMetricsSnapshot::BUCKETS; ++i)
+        snapshot.sojourn[i] = sojourn_[i].load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+#else
+
+inline CSyncMetrics::CSyncMetrics() {}
+inline void CSyncMetrics::pushed(size_t) {}
+template <class T>
+void CSyncMetrics::popped(const T&) {}
+template <class T>
+void CSyncMetrics::popped(const CTimestamped<T>&) {}
+inline CSyncMetrics::Stamp CSyncMetrics::sleepBegin()
+{
+    return Stamp();
+}
+inline void CSyncMetrics::sleepEnd(const Stamp&) {}
+inline void CSyncMetrics::recordSojourn(std::chrono::nanoseconds) {}
+inline CSyncMetricsSnapshot CSyncMetrics::snapshot(size_t depth) const
+{
+    CSyncMetricsSnapshot snapshot;
+    snapshot.depth = depth;
+    return snapshot;
+}
+
+#endif
+
+#endif
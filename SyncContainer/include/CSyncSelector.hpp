@@ -0,0 +1,257 @@
+#ifndef C_SYNC_SELECTOR
+#define C_SYNC_SELECTOR
+
+#include "CSyncListeners.hpp"
+#include "CEventCount.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+//Waits on several CSyncContainers with the same value_type at once.
+//The selector attaches itself as a listener to every source and sleeps on its own eventcount,
+//so a consumer never holds more than one source lock at a time. A popping thread arms every source
+//before it sleeps, producers pay one load per push while no selector thread is about to sleep.
+//PRIORITY always tries the sources in the order they were added, ROUND_ROBIN starts after the
+//source that served the previous pop. Sources must be added before the first pop and outlive
+//the selector. Several threads may pop from one selector.
+template <class T>
+class CSyncSelector: private ISyncListener
+{
+    public:
+        enum Order
+        {
+            PRIORITY, ROUND_ROBIN
+        };
+
+        explicit CSyncSelector(Order order = PRIORITY);
+        ~CSyncSelector();
+
+        //Returns the index popAny reports for items from source
+        template <class SOURCE>
+        size_t add(SOURCE& source);
+        //Return the index of the source the item came from, -1 once every source is terminated and empty
+        int popAny(T& item);
+        int popAnyNoSleep(T& item);
+        //Also -1 on timeout
+        template <class Rep, class Period>
+        int popAnyFor(T& item, const std::chrono::duration<Rep, Period>& timeout);
+        template <class Clock, class Duration>
+        int popAnyUntil(T& item, const std::chrono::time_point<Clock, Duration>& deadline);
+        size_t sources() const;
+        //Every source is terminated
+        bool isTerminated() const;
+
+    private:
+        class ISource
+        {
+            public:
+                virtual ~ISource() {}
+                virtual bool popNoSleep(T& item) = 0;
+                virtual bool isTerminated() const = 0;
+                virtual void arm() = 0;
+                virtual void disarm() = 0;
+        };
+
+        template <class SOURCE>
+        class CSource: public ISource
+        {
+            public:
+                CSource(SOURCE& source, ISyncListener* listener):source_(source), listener_(listener)
+                {
+                    source_.attach(listener_);
+                }
+                ~CSource()
+                {
+                    source_.detach(listener_);
+                }
+                bool popNoSleep(T& item)
+                {
+                    return source_.popNoSleep(item);
+                }
+                bool isTerminated() const
+                {
+                    return source_.isTerminated();
+                }
+                void arm()
+                {
+                    source_.arm();
+                }
+                void disarm()
+                {
+                    source_.disarm();
+                }
+            private:
+                SOURCE& source_;
+                ISyncListener* listener_;
+        };
+
+        const Order order_;
+        std::vector<std::unique_ptr<ISource>> sources_;
+        std::atomic<size_t> next_;
+        //Threads between arm() and disarm()
+        std::atomic<int> armed_;
+        CEventCount event_;
+
+        CSyncSelector(const CSyncSelector& selector) = delete;
+
+        void notify(bool all);
+        bool armed() const;
+        void arm();
+        void disarm();
+        int tryPop(T& item);
+};
+
+
+
+template <class T>
+CSyncSelector<T>::CSyncSelector(Order order):order_(order)
+{
+    next_.store(0);
+    armed_.store(0);
+}
+
+template <class T>
+CSyncSelector<T>::~CSyncSelector()
+{
+    //Detaching first guarantees no producer is inside notify when the eventcount goes away
+    sources_.clear();
+}
+
+template <class T>
+template <class SOURCE>
+size_t CSyncSelector<T>::add(SOURCE& source)
+{
+    sources_.emplace_back(new CSource<SOURCE>(source, this));
+    return sources_.size() - 1;
+}
+
+template <class T>
+int CSyncSelector<T>::popAny(T& item)
+{
+    while(true)
+    {
+        int index = tryPop(item);
+        if(index >= 0)
+            return index;
+        auto key = event_.prepareWait();
+        arm();
+        //Termination has to be read before the last check, an item pushed before terminate is still popped
+        bool terminated = isTerminated();
+        index = tryPop(item);
+        if(index >= 0 || terminated)
+        {
+            disarm();
+            event_.cancelWait();
+            return index;
+        }
+        event_.wait(key);
+        disarm();
+    }
+}
+
+template <class T>
+int CSyncSelector<T>::popAnyNoSleep(T& item)
+{
+    return tryPop(item);
+}
+
+template <class T>
+template <class Rep, class Period>
+int CSyncSelector<T>::popAnyFor(T& item, const std::chrono::duration<Rep, Period>& timeout)
+{
+    return popAnyUntil(item, std::chrono::steady_clock::now() + timeout);
+}
+
+template <class T>
+template <class Clock, class Duration>
+int CSyncSelector<T>::popAnyUntil(T& item, const std::chrono::time_point<Clock, Duration>& deadline)
+{
+    while(true)
+    {
+        int index = tryPop(item);
+        if(index >= 0)
+            return index;
+        auto key = event_.prepareWait();
+        arm();
+        bool terminated = isTerminated();
+        index = tryPop(item);
+        if(index >= 0 || terminated)
+        {
+            disarm();
+            event_.cancelWait();
+            return index;
+        }
+        bool woken = event_.waitUntil(key, deadline);
+        disarm();
+        if(!woken)
+            return tryPop(item);
+    }
+}
+
+template <class T>
+size_t CSyncSelector<T>::sources() const
+{
+    return sources_.size();
+}
+
+template <class T>
+bool CSyncSelector<T>::isTerminated() const
+{
+    for(auto& source: sources_)
+        if(!source->isTerminated())
+            return false;
+    return true;
+}
+
+template <class T>
+void CSyncSelector<T>::notify(bool all)
+{
+    if(all)
+        event_.notifyAll();
+    else
+        event_.notify();
+}
+
+template <class T>
+bool CSyncSelector<T>::armed() const
+{
+    return armed_.load() != 0;
+}
+
+//Before the last check for an item: a producer that finds the selector unarmed pushed before it
+template <class T>
+void CSyncSelector<T>::arm()
+{
+    armed_.fetch_add(1);
+    for(auto& source: sources_)
+        source->arm();
+}
+
+template <class T>
+void CSyncSelector<T>::disarm()
+{
+    for(auto& source: sources_)
+        source->disarm();
+    armed_.fetch_sub(1);
+}
+
+template <class T>
+int CSyncSelector<T>::tryPop(T& item)
+{
+    size_t count = sources_.size();
+    size_t first = order_ == ROUND_ROBIN ? next_.load(std::memory_order_relaxed) : 0;
+    for(size_t i = 0; i < count; ++i)
+    {
+        size_t index = (first + i) % count;
+        if(sources_[index]->popNoSleep(item))
+        {
+            if(order_ == ROUND_ROBIN)
+                next_.store(index + 1, std::memory_order_relaxed);
+            return int(index);
+        }
+    }
+    return -1;
+}
+
+#endif
@@ -1,23 +1,47 @@
 #include "CSyncContainer.hpp"
+#include "CShardedSyncContainer.hpp"
+#include "CSyncContainerLockFree.hpp"
+#include "CSyncContainerHeap.hpp"
+#include "CPipeline.hpp"
+#include "CSyncSelector.hpp"
+#include "CSharedSyncContainer.hpp"
+#include "CSyncExecutor.hpp"
+#include "CpuTopology.hpp"
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fstream>
+#include <string>
+#include <set>
+#include <algorithm>
 #include <thread>
 #include <functional>
 #include <deque>
 #include <iostream>
+#include <memory>
 
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE C_SYNC_QUEUE_TEST
 #include <boost/test/unit_test.hpp>
 
-template <class CONTAINER>
-void Produce(unsigned int itemsCount, CSyncContainer<CONTAINER>& queue)
+template <class CONTAINER, class BACKEND>
+void Produce(unsigned int itemsCount, CSyncContainer<CONTAINER, BACKEND>& queue)
 {
     for(int i = 0; i < itemsCount; ++i)
     {
         queue.push(1);
     }
 }
-template <typename T, class CONTAINER>
-void ConsumeOrSleep(unsigned int itemsCount, CSyncContainer<CONTAINER>& queue, std::vector<T>* consumed)
+template <class CONTAINER, class BACKEND>
+void ProduceOrSleep(unsigned int itemsCount, CSyncContainer<CONTAINER, BACKEND>& queue)
+{
+    for(int i = 0; i < itemsCount; ++i)
+    {
+        if(!queue.pushOrSleep(1))
+            break;
+    }
+}
+template <typename T, class CONTAINER, class BACKEND>
+void ConsumeOrSleep(unsigned int itemsCount, CSyncContainer<CONTAINER, BACKEND>& queue, std::vector<T>* consumed)
 {
     for(int i = 0; i < itemsCount; ++i)
     {
@@ -28,8 +52,8 @@ void ConsumeOrSleep(unsigned int itemsCount, CSyncContainer<CONTAINER>& queue, s
             break;
     }
 }
-template <typename T, class CONTAINER>
-void ConsumeNoSleep(unsigned int itemsCount, CSyncContainer<CONTAINER>& queue, std::vector<T>* consumed)
+template <typename T, class CONTAINER, class BACKEND>
+void ConsumeNoSleep(unsigned int itemsCount, CSyncContainer<CONTAINER, BACKEND>& queue, std::vector<T>* consumed)
 {
     for(int i = 0; i < itemsCount; ++i)
     {
@@ -40,47 +64,64 @@ void ConsumeNoSleep(unsigned int itemsCount, CSyncContainer<CONTAINER>& queue, s
             break;
     }
 }
-template <typename T, class CONTAINER>
-std::vector<std::thread*> GenerateProducerPool(unsigned int n, unsigned int itemsPerProducer, CSyncContainer<CONTAINER>& queue)
+//Consumers are spread over packages and cores first, so they really contend across caches
+void PinPool(const std::vector<std::thread*>& threads)
+{
+    auto placement = CpuTopology::instance().placement(CpuTopology::SCATTER, threads.size());
+    for(size_t i = 0; i < threads.size(); ++i)
+        CpuTopology::pin(*threads[i], placement[i]);
+}
+template <typename T, class CONTAINER, class BACKEND>
+std::vector<std::thread*> GenerateProducerPool(unsigned int n, unsigned int itemsPerProducer, CSyncContainer<CONTAINER, BACKEND>& queue)
+{
+    std::vector<std::thread*> threads;
+    for(int i = 0; i < n; ++i)
+        threads.push_back(new std::thread(Produce<CONTAINER, BACKEND>, itemsPerProducer, std::ref(queue)));
+    return threads;
+}
+template <typename T, class CONTAINER, class BACKEND>
+std::vector<std::thread*> GenerateBoundedProducerPool(unsigned int n, unsigned int itemsPerProducer, CSyncContainer<CONTAINER, BACKEND>& queue)
 {
     std::vector<std::thread*> threads;
     for(int i = 0; i < n; ++i)
-        threads.push_back(new std::thread(Produce<CONTAINER>, itemsPerProducer, std::ref(queue)));
+        threads.push_back(new std::thread(ProduceOrSleep<CONTAINER, BACKEND>, itemsPerProducer, std::ref(queue)));
     return threads;
 }
-template <typename T, class CONTAINER>
+template <typename T, class CONTAINER, class BACKEND>
 std::vector<std::thread*> GenerateConsumerNonSleepingPool(unsigned int n, unsigned int itemsPerConsumer, std::vector<std::vector<T>*>& items,
-                                               CSyncContainer<CONTAINER>& queue)
+                                               CSyncContainer<CONTAINER, BACKEND>& queue)
 {
     std::vector<std::thread*> threads;
     for(int i = 0; i < n; ++i)
-        threads.push_back(new std::thread(ConsumeNoSleep<T, CONTAINER>, itemsPerConsumer, std::ref(queue), items[i]));
+        threads.push_back(new std::thread(ConsumeNoSleep<T, CONTAINER, BACKEND>, itemsPerConsumer, std::ref(queue), items[i]));
+    PinPool(threads);
     return threads;
 }
-template <typename T, class CONTAINER>
+template <typename T, class CONTAINER, class BACKEND>
 std::vector<std::thread*> GenerateConsumerPool(unsigned int n, unsigned int itemsPerConsumer, std::vector<std::vector<T>*>& items,
-                                               CSyncContainer<CONTAINER>& queue)
+                                               CSyncContainer<CONTAINER, BACKEND>& queue)
 {
     std::vector<std::thread*> threads;
     for(int i = 0; i < n; ++i)
-        threads.push_back(new std::thread(ConsumeOrSleep<T, CONTAINER>, itemsPerConsumer, std::ref(queue), items[i]));
+        threads.push_back(new std::thread(ConsumeOrSleep<T, CONTAINER, BACKEND>, itemsPerConsumer, std::ref(queue), items[i]));
+    PinPool(threads);
     return threads;
 }
 
 
-template <class CONTAINER>
+template <class CONTAINER, class BACKEND = CLockingBackend>
 void TestPopOrSleep()
 {
     int itemsPerProducer = 100000;
     const int nProduceres = 8;
     const int itemsPerConsumer = 50000;
     const int nConsumers = 8;
-    CSyncContainer<CONTAINER> queue;
+    CSyncContainer<CONTAINER, BACKEND> queue;
     std::vector<std::vector<int>*> consumers;
     for(int i = 0; i < nConsumers; ++i)
         consumers.push_back(new std::vector<int>());
-    auto prThr1 = GenerateProducerPool<int, CONTAINER>(nProduceres, itemsPerProducer, queue);
-    auto consThr1 = GenerateConsumerPool<int,CONTAINER>(nConsumers, itemsPerConsumer, consumers, queue);
+    auto prThr1 = GenerateProducerPool<int, CONTAINER, BACKEND>(nProduceres, itemsPerProducer, queue);
+    auto consThr1 = GenerateConsumerPool<int, CONTAINER, BACKEND>(nConsumers, itemsPerConsumer, consumers, queue);
     for(auto th: prThr1)
     {
         th->join();
@@ -102,7 +143,7 @@ void TestPopOrSleep()
     std::cout << std::endl;
     std::cout << "sum: " << sum << std::endl;
     BOOST_CHECK(queue.size() + sum == itemsPerProducer * nProduceres);
-    auto prThr2 = GenerateConsumerPool<int, CONTAINER>(nConsumers, itemsPerConsumer, consumers, queue);
+    auto prThr2 = GenerateConsumerPool<int, CONTAINER, BACKEND>(nConsumers, itemsPerConsumer, consumers, queue);
 
     for(auto th: prThr2)
     {
@@ -125,8 +166,8 @@ void TestPopOrSleep()
     std::cout << "With termination:" << std::endl;
     for(auto cons: consumers)
         cons->clear();
-    prThr1 = GenerateProducerPool<int, CONTAINER>(nProduceres, itemsPerProducer, queue);
-    consThr1 = GenerateConsumerPool<int,CONTAINER>(nConsumers, 10*itemsPerConsumer, consumers, queue);
+    prThr1 = GenerateProducerPool<int, CONTAINER, BACKEND>(nProduceres, itemsPerProducer, queue);
+    consThr1 = GenerateConsumerPool<int, CONTAINER, BACKEND>(nConsumers, 10*itemsPerConsumer, consumers, queue);
     for(auto th: prThr1)
     {
         th->join();
@@ -155,8 +196,8 @@ void TestPopOrSleep()
         cons->clear();
     std::cout << "With restart" << std::endl;
     queue.restart();
-    consThr1 = GenerateConsumerPool<int,CONTAINER>(nConsumers, 10*itemsPerConsumer, consumers, queue);
-    prThr1 = GenerateProducerPool<int, CONTAINER>(nProduceres, itemsPerProducer, queue);
+    consThr1 = GenerateConsumerPool<int, CONTAINER, BACKEND>(nConsumers, 10*itemsPerConsumer, consumers, queue);
+    prThr1 = GenerateProducerPool<int, CONTAINER, BACKEND>(nProduceres, itemsPerProducer, queue);
     for(auto th: prThr1)
     {
         th->join();
@@ -183,13 +224,13 @@ void TestPopOrSleep()
     for(auto cons: consumers)
         cons->clear();
     std::cout << "Without restart" << std::endl;
-    consThr1 = GenerateConsumerPool<int,CONTAINER>(nConsumers, 10*itemsPerConsumer, consumers, queue);
+    consThr1 = GenerateConsumerPool<int, CONTAINER, BACKEND>(nConsumers, 10*itemsPerConsumer, consumers, queue);
     for(auto th: consThr1)
     {
         th->join();
         delete th;
     }
-    prThr1 = GenerateProducerPool<int, CONTAINER>(nProduceres, itemsPerProducer, queue);
+    prThr1 = GenerateProducerPool<int, CONTAINER, BACKEND>(nProduceres, itemsPerProducer, queue);
     for(auto th: prThr1)
     {
         th->join();
@@ -210,19 +251,19 @@ void TestPopOrSleep()
     for(auto cons: consumers)
         delete cons;
 }
-template <class CONTAINER>
+template <class CONTAINER, class BACKEND = CLockingBackend>
 void TestPopNoSleep()
 {
     int itemsPerProducer = 100000;
     const int nProduceres = 4;
     const int itemsPerConsumer = 50000;
     const int nConsumers = 8;
-    CSyncContainer<CONTAINER> queue;
+    CSyncContainer<CONTAINER, BACKEND> queue;
     std::vector<std::vector<int>*> consumers;
     for(int i = 0; i < nConsumers; ++i)
         consumers.push_back(new std::vector<int>());
-    auto prThr1 = GenerateProducerPool<int, CONTAINER>(nProduceres, itemsPerProducer, queue);
-    auto consThr1 = GenerateConsumerNonSleepingPool<int, CONTAINER>(nConsumers, itemsPerConsumer, consumers, queue);
+    auto prThr1 = GenerateProducerPool<int, CONTAINER, BACKEND>(nProduceres, itemsPerProducer, queue);
+    auto consThr1 = GenerateConsumerNonSleepingPool<int, CONTAINER, BACKEND>(nConsumers, itemsPerConsumer, consumers, queue);
     for(auto th: prThr1)
     {
         th->join();
@@ -244,7 +285,7 @@ void TestPopNoSleep()
     std::cout << std::endl;
     std::cout << "sum: " << sum << std::endl;
     BOOST_CHECK(queue.size() + sum == itemsPerProducer * nProduceres);
-    auto prThr2 = GenerateConsumerNonSleepingPool<int, CONTAINER>(nConsumers, itemsPerConsumer, consumers, queue);
+    auto prThr2 = GenerateConsumerNonSleepingPool<int, CONTAINER, BACKEND>(nConsumers, itemsPerConsumer, consumers, queue);
 
     for(auto th: prThr2)
     {
@@ -266,6 +307,493 @@ void TestPopNoSleep()
     for(auto cons: consumers)
         delete cons;
 }
+template <class CONTAINER, class BACKEND = CLockingBackend>
+void TestBoundedPush()
+{
+    const size_t capacity = 16;
+    const int itemsPerProducer = 20000;
+    const int nProduceres = 4;
+    const int itemsPerConsumer = 20000;
+    const int nConsumers = 4;
+    CSyncContainer<CONTAINER, BACKEND> queue(capacity);
+    BOOST_CHECK(queue.capacity() == capacity);
+    std::vector<std::vector<int>*> consumers;
+    for(int i = 0; i < nConsumers; ++i)
+        consumers.push_back(new std::vector<int>());
+    std::atomic<size_t> maxSize(0);
+    std::atomic<bool> producing(true);
+    auto monitor = new std::thread([&](){
+        while(producing.load())
+        {
+            size_t size = queue.size();
+            if(size > maxSize.load())
+                maxSize.store(size);
+            std::this_thread::yield();
+        }
+    });
+    auto prThr = GenerateBoundedProducerPool<int, CONTAINER, BACKEND>(nProduceres, itemsPerProducer, queue);
+    auto consThr = GenerateConsumerPool<int, CONTAINER, BACKEND>(nConsumers, itemsPerConsumer, consumers, queue);
+    for(auto th: prThr)
+    {
+        th->join();
+        delete th;
+    }
+    for(auto th: consThr)
+    {
+        th->join();
+        delete th;
+    }
+    producing.store(false);
+    monitor->join();
+    delete monitor;
+    size_t sum = 0;
+    for(int i = 0; i < nConsumers; ++i)
+        sum += consumers[i]->size();
+    std::cout << "Max size: " << maxSize.load() << std::endl;
+    std::cout << "sum: " << sum << std::endl;
+    BOOST_CHECK(maxSize.load() <= capacity);
+    BOOST_CHECK(queue.size() == 0);
+    BOOST_CHECK(sum == itemsPerProducer * nProduceres);
+
+    std::cout << "tryPush/pushFor on full container" << std::endl;
+    for(size_t i = 0; i < capacity; ++i)
+        BOOST_CHECK(queue.tryPush(1));
+    BOOST_CHECK(!queue.tryPush(1));
+    auto start = std::chrono::steady_clock::now();
+    BOOST_CHECK(!queue.pushFor(1, std::chrono::milliseconds(20)));
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+    BOOST_CHECK(queue.size() == capacity);
+    int item;
+    BOOST_CHECK(queue.popNoSleep(item));
+    BOOST_CHECK(queue.pushFor(1, std::chrono::milliseconds(20)));
+
+    std::cout << "With termination:" << std::endl;
+    bool pushed = true;
+    auto blocked = new std::thread([&](){
+        pushed = queue.pushOrSleep(1);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.terminate();
+    blocked->join();
+    delete blocked;
+    BOOST_CHECK(!pushed);
+    BOOST_CHECK(queue.size() == capacity);
+    BOOST_CHECK(queue.popOrSleep(item));
+    BOOST_CHECK(queue.pushOrSleep(1));
+    queue.restart();
+    for(auto cons: consumers)
+        delete cons;
+}
+template <typename T, class CONTAINER, class BACKEND>
+void ConsumeFor(unsigned int itemsCount, CSyncContainer<CONTAINER, BACKEND>& queue, std::vector<T>* consumed)
+{
+    for(int i = 0; i < itemsCount; ++i)
+    {
+        T item;
+        if(queue.popFor(item, std::chrono::seconds(5)))
+            consumed->push_back(item);
+        else
+            break;
+    }
+}
+template <class CONTAINER, class BACKEND = CLockingBackend>
+void TestTimedPop()
+{
+    CSyncContainer<CONTAINER, BACKEND> queue;
+    int item;
+    auto start = std::chrono::steady_clock::now();
+    BOOST_CHECK(!queue.popFor(item, std::chrono::milliseconds(20)));
+    BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+    start = std::chrono::steady_clock::now();
+    BOOST_CHECK(!queue.popUntil(item, start + std::chrono::milliseconds(20)));
+    BOOST_CHECK(std::chrono::steady_clock::now() >= start + std::chrono::milliseconds(20));
+    BOOST_CHECK(!queue.popUntil(item, start));
+
+    queue.push(5);
+    BOOST_CHECK(queue.popFor(item, std::chrono::seconds(0)));
+    BOOST_CHECK(item == 5);
+
+    std::cout << "Wakeup before deadline" << std::endl;
+    auto producer = new std::thread([&](){
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        queue.push(7);
+    });
+    item = 0;
+    BOOST_CHECK(queue.popFor(item, std::chrono::seconds(10)));
+    BOOST_CHECK(item == 7);
+    producer->join();
+    delete producer;
+
+    std::cout << "With termination:" << std::endl;
+    bool popped = true;
+    auto consumer = new std::thread([&](){
+        int value;
+        popped = queue.popUntil(value, std::chrono::steady_clock::now() + std::chrono::seconds(10));
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    start = std::chrono::steady_clock::now();
+    queue.terminate();
+    consumer->join();
+    delete consumer;
+    BOOST_CHECK(!popped);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+    queue.restart();
+
+    std::cout << "Producer/consumer pools:" << std::endl;
+    const int itemsPerProducer = 50000;
+    const int nProduceres = 4;
+    const int nConsumers = 4;
+    std::vector<std::vector<int>*> consumers;
+    for(int i = 0; i < nConsumers; ++i)
+        consumers.push_back(new std::vector<int>());
+    auto prThr = GenerateProducerPool<int, CONTAINER, BACKEND>(nProduceres, itemsPerProducer, queue);
+    std::vector<std::thread*> consThr;
+    for(int i = 0; i < nConsumers; ++i)
+        consThr.push_back(new std::thread(ConsumeFor<int, CONTAINER, BACKEND>, itemsPerProducer * nProduceres, std::ref(queue), consumers[i]));
+    for(auto th: prThr)
+    {
+        th->join();
+        delete th;
+    }
+    queue.terminate();
+    for(auto th: consThr)
+    {
+        th->join();
+        delete th;
+    }
+    size_t sum = 0;
+    for(int i = 0; i < nConsumers; ++i)
+        sum += consumers[i]->size();
+    std::cout << "sum: " << sum << std::endl;
+    BOOST_CHECK(queue.size() == 0);
+    BOOST_CHECK(sum == itemsPerProducer * nProduceres);
+    for(auto cons: consumers)
+        delete cons;
+}
+BOOST_AUTO_TEST_CASE(queueFifoOrder)
+{
+    std::cout << "queueFifoOrder" << std::endl;
+    const int nProduceres = 4;
+    const int itemsPerProducer = 100000;
+    CSyncContainer<std::queue<int>> queue;
+    std::vector<int> consumed;
+    std::vector<std::thread*> threads;
+    for(int i = 0; i < nProduceres; ++i)
+        threads.push_back(new std::thread([&queue, i, itemsPerProducer](){
+            for(int j = 0; j < itemsPerProducer; ++j)
+                queue.push(i * itemsPerProducer + j);
+        }));
+    auto consumer = new std::thread(ConsumeOrSleep<int, std::queue<int>, CLockingBackend>, nProduceres * itemsPerProducer,
+                                    std::ref(queue), &consumed);
+    for(auto th: threads)
+    {
+        th->join();
+        delete th;
+    }
+    consumer->join();
+    delete consumer;
+    BOOST_CHECK(consumed.size() == nProduceres * itemsPerProducer);
+    BOOST_CHECK(queue.size() == 0);
+    std::vector<int> last(nProduceres, -1);
+    bool ordered = true;
+    for(auto item: consumed)
+    {
+        int producer = item / itemsPerProducer;
+        if(item <= last[producer])
+            ordered = false;
+        last[producer] = item;
+    }
+    BOOST_CHECK(ordered);
+    std::cout << std::endl;
+}
+template <class CONTAINER>
+void TestSharded()
+{
+    const int itemsPerProducer = 100000;
+    const int nProduceres = 8;
+    const int nConsumers = 8;
+    CShardedSyncContainer<CONTAINER> queue(4);
+    BOOST_CHECK(queue.shards() == 4);
+    std::vector<std::vector<int>> consumers(nConsumers);
+    std::vector<std::thread*> threads;
+    for(int i = 0; i < nConsumers; ++i)
+        threads.push_back(new std::thread([&queue, &consumers, i](){
+            int item;
+            while(queue.popOrSleep(item))
+                consumers[i].push_back(item);
+        }));
+    std::vector<std::thread*> producers;
+    for(int i = 0; i < nProduceres; ++i)
+        producers.push_back(new std::thread([&queue, i, itemsPerProducer](){
+            for(int j = 0; j < itemsPerProducer; ++j)
+                queue.push(i * itemsPerProducer + j);
+        }));
+    for(auto th: producers)
+    {
+        th->join();
+        delete th;
+    }
+    queue.terminate();
+    for(auto th: threads)
+    {
+        th->join();
+        delete th;
+    }
+    std::vector<bool> verify(nProduceres * itemsPerProducer, false);
+    size_t sum = 0;
+    bool duplicates = false;
+    for(auto& consumed: consumers)
+    {
+        sum += consumed.size();
+        for(auto item: consumed)
+        {
+            if(verify[item])
+                duplicates = true;
+            verify[item] = true;
+        }
+    }
+    std::cout << "sum: " << sum << std::endl;
+    BOOST_CHECK(!duplicates);
+    BOOST_CHECK(sum == nProduceres * itemsPerProducer);
+    BOOST_CHECK(queue.size() == 0);
+    int item;
+    BOOST_CHECK(!queue.popOrSleep(item));
+    queue.restart();
+    queue.push(1);
+    BOOST_CHECK(queue.size() == 1);
+    BOOST_CHECK(queue.popNoSleep(item));
+    BOOST_CHECK(!queue.popNoSleep(item));
+}
+struct CopyCounter
+{
+    static std::atomic<int> copies;
+    CopyCounter():value(0) {}
+    explicit CopyCounter(int value):value(value) {}
+    CopyCounter(const CopyCounter& other):value(other.value) { ++copies; }
+    CopyCounter(CopyCounter&& other) = default;
+    CopyCounter& operator=(const CopyCounter& other) { value = other.value; ++copies; return *this; }
+    CopyCounter& operator=(CopyCounter&& other) = default;
+    int value;
+};
+std::atomic<int> CopyCounter::copies(0);
+
+template <template <class...> class CONTAINER, class BACKEND = CLockingBackend>
+void TestMoveOnly()
+{
+    const int itemsPerProducer = 20000;
+    const int nProduceres = 4;
+    const int nConsumers = 4;
+    CSyncContainer<CONTAINER<std::unique_ptr<int>>, BACKEND> queue;
+    std::vector<long long> sums(nConsumers, 0);
+    std::vector<std::thread*> threads;
+    for(int i = 0; i < nConsumers; ++i)
+        threads.push_back(new std::thread([&queue, &sums, i](){
+            std::unique_ptr<int> item;
+            while(queue.popOrSleep(item))
+            {
+                sums[i] += *item;
+                item.reset();
+            }
+        }));
+    std::vector<std::thread*> producers;
+    for(int i = 0; i < nProduceres; ++i)
+        producers.push_back(new std::thread([&queue, i, itemsPerProducer](){
+            for(int j = 0; j < itemsPerProducer; ++j)
+            {
+                if(j % 2 == 0)
+                    queue.push(std::unique_ptr<int>(new int(1)));
+                else
+                    queue.emplace(new int(1));
+            }
+        }));
+    for(auto th: producers)
+    {
+        th->join();
+        delete th;
+    }
+    queue.terminate();
+    for(auto th: threads)
+    {
+        th->join();
+        delete th;
+    }
+    long long sum = 0;
+    for(auto consumed: sums)
+        sum += consumed;
+    std::cout << "sum: " << sum << std::endl;
+    BOOST_CHECK(sum == itemsPerProducer * nProduceres);
+    BOOST_CHECK(queue.size() == 0);
+
+    std::cout << "Rejected rvalue push keeps the item" << std::endl;
+    CSyncContainer<CONTAINER<std::unique_ptr<int>>, BACKEND> bounded(1);
+    BOOST_CHECK(bounded.tryPush(std::unique_ptr<int>(new int(1))));
+    std::unique_ptr<int> rejected(new int(2));
+    BOOST_CHECK(!bounded.tryPush(std::move(rejected)));
+    BOOST_CHECK(rejected && *rejected == 2);
+    BOOST_CHECK(!bounded.pushFor(std::move(rejected), std::chrono::milliseconds(1)));
+    BOOST_CHECK(rejected && *rejected == 2);
+
+    std::cout << "Zero copies" << std::endl;
+    CSyncContainer<CONTAINER<CopyCounter>, BACKEND> counters;
+    CopyCounter::copies.store(0);
+    for(int i = 0; i < 100; ++i)
+    {
+        counters.push(CopyCounter(i));
+        counters.emplace(i);
+        CopyCounter counter(i);
+        BOOST_CHECK(counters.tryPush(std::move(counter)));
+        BOOST_CHECK(counters.pushOrSleep(CopyCounter(i)));
+    }
+    CopyCounter counter;
+    while(counters.popNoSleep(counter));
+    BOOST_CHECK(CopyCounter::copies.load() == 0);
+    CopyCounter copied(1);
+    counters.push(copied);
+    BOOST_CHECK(CopyCounter::copies.load() == 1);
+}
+//Containers outside the std adaptors plug in through CContainerTraits
+template <>
+struct CContainerTraits<std::multiset<int>>
+{
+    template <class... Args>
+    static void emplace(std::multiset<int>& container, Args&&... args)
+    {
+        container.emplace(std::forward<Args>(args)...);
+    }
+    static void pop(std::multiset<int>& container, int& item)
+    {
+        item = *container.begin();
+        container.erase(container.begin());
+    }
+};
+template <class BACKEND>
+void TestPriority()
+{
+    CSyncContainer<std::priority_queue<int>, BACKEND> ordered;
+    for(int i = 0; i < 1000; ++i)
+        ordered.push((i * 7919) % 1000);
+    int item;
+    int last = 1000;
+    bool sorted = true;
+    while(ordered.popNoSleep(item))
+    {
+        if(item > last)
+            sorted = false;
+        last = item;
+    }
+    BOOST_CHECK(sorted);
+    BOOST_CHECK(last == 0);
+
+    std::cout << "Concurrent push and pop" << std::endl;
+    const int itemsPerProducer = 50000;
+    const int nProduceres = 4;
+    const int nConsumers = 4;
+    CSyncContainer<std::priority_queue<int>, BACKEND> queue;
+    std::vector<std::vector<int>> consumers(nConsumers);
+    std::vector<std::thread*> threads;
+    for(int i = 0; i < nConsumers; ++i)
+        threads.push_back(new std::thread([&queue, &consumers, i](){
+            int value;
+            while(queue.popOrSleep(value))
+                consumers[i].push_back(value);
+        }));
+    std::vector<std::thread*> producers;
+    for(int i = 0; i < nProduceres; ++i)
+        producers.push_back(new std::thread([&queue, i, itemsPerProducer](){
+            for(int j = 0; j < itemsPerProducer; ++j)
+                queue.push(j * nProduceres + i);
+        }));
+    for(auto th: producers)
+    {
+        th->join();
+        delete th;
+    }
+    queue.terminate();
+    for(auto th: threads)
+    {
+        th->join();
+        delete th;
+    }
+    std::vector<bool> verify(nProduceres * itemsPerProducer, false);
+    size_t sum = 0;
+    bool duplicates = false;
+    for(auto& consumed: consumers)
+    {
+        sum += consumed.size();
+        for(auto value: consumed)
+        {
+            if(verify[value])
+                duplicates = true;
+            verify[value] = true;
+        }
+    }
+    std::cout << "sum: " << sum << std::endl;
+    BOOST_CHECK(!duplicates);
+    BOOST_CHECK(sum == nProduceres * itemsPerProducer);
+    BOOST_CHECK(queue.size() == 0);
+
+    std::cout << "Order after concurrent pushes" << std::endl;
+    queue.restart();
+    producers.clear();
+    for(int i = 0; i < nProduceres; ++i)
+        producers.push_back(new std::thread([&queue, i, itemsPerProducer](){
+            for(int j = 0; j < itemsPerProducer; ++j)
+                queue.push((j * 7919 + i) % itemsPerProducer);
+        }));
+    for(auto th: producers)
+    {
+        th->join();
+        delete th;
+    }
+    BOOST_CHECK(queue.size() == nProduceres * itemsPerProducer);
+    last = itemsPerProducer;
+    sorted = true;
+    sum = 0;
+    while(queue.popNoSleep(item))
+    {
+        if(item > last)
+            sorted = false;
+        last = item;
+        ++sum;
+    }
+    BOOST_CHECK(sorted);
+    BOOST_CHECK(sum == nProduceres * itemsPerProducer);
+}
+BOOST_AUTO_TEST_CASE(customTraits)
+{
+    std::cout << "customTraits" << std::endl;
+    CSyncContainer<std::multiset<int>> queue;
+    for(int i: {5, 1, 4, 2, 3})
+        queue.push(i);
+    int item;
+    for(int i = 1; i <= 5; ++i)
+    {
+        BOOST_CHECK(queue.popOrSleep(item));
+        BOOST_CHECK(item == i);
+    }
+    BOOST_CHECK(!queue.popNoSleep(item));
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(adaptiveSpin)
+{
+    std::cout << "adaptiveSpin" << std::endl;
+    CAdaptiveSpin spin(std::chrono::microseconds(50));
+    BOOST_CHECK(spin.budget().count() == 0);
+    //Arrivals are sampled, enough of them that at least two samples are all but certain
+    for(int i = 0; i < 1000; ++i)
+        spin.recordArrival();
+    BOOST_CHECK(spin.budget() <= std::chrono::microseconds(50));
+    if(std::thread::hardware_concurrency() > 1)
+        BOOST_CHECK(spin.budget().count() > 0);
+    int polls = 0;
+    BOOST_CHECK(spin.spinUntil([&polls](){ return ++polls == 3; }) || spin.budget().count() == 0);
+    spin.setMaxSpin(std::chrono::nanoseconds(0));
+    BOOST_CHECK(spin.budget().count() == 0);
+    polls = 0;
+    BOOST_CHECK(!spin.spinUntil([&polls](){ ++polls; return false; }));
+    BOOST_CHECK(polls == 1);
+    std::cout << std::endl;
+}
 BOOST_AUTO_TEST_CASE(popOrSleepList)
 {
     std::cout << "popOrSleepList" << std::endl;
@@ -326,3 +854,813 @@ BOOST_AUTO_TEST_CASE(popNoSleepStack)
     TestPopNoSleep<std::stack<int>>();
     std::cout << std::endl;
 }
+BOOST_AUTO_TEST_CASE(boundedPushList)
+{
+    std::cout << "boundedPushList" << std::endl;
+    TestBoundedPush<std::list<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(boundedPushVector)
+{
+    std::cout << "boundedPushVector" << std::endl;
+    TestBoundedPush<std::vector<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(boundedPushDeque)
+{
+    std::cout << "boundedPushDeque" << std::endl;
+    TestBoundedPush<std::deque<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(boundedPushQueue)
+{
+    std::cout << "boundedPushQueue" << std::endl;
+    TestBoundedPush<std::queue<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(boundedPushStack)
+{
+    std::cout << "boundedPushStack" << std::endl;
+    TestBoundedPush<std::stack<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(timedPopDeque)
+{
+    std::cout << "timedPopDeque" << std::endl;
+    TestTimedPop<std::deque<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(timedPopQueue)
+{
+    std::cout << "timedPopQueue" << std::endl;
+    TestTimedPop<std::queue<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(timedPopStack)
+{
+    std::cout << "timedPopStack" << std::endl;
+    TestTimedPop<std::stack<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(shardedQueue)
+{
+    std::cout << "shardedQueue" << std::endl;
+    TestSharded<std::queue<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(shardedDeque)
+{
+    std::cout << "shardedDeque" << std::endl;
+    TestSharded<std::deque<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(moveOnlyList)
+{
+    std::cout << "moveOnlyList" << std::endl;
+    TestMoveOnly<std::list>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(moveOnlyVector)
+{
+    std::cout << "moveOnlyVector" << std::endl;
+    TestMoveOnly<std::vector>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(moveOnlyDeque)
+{
+    std::cout << "moveOnlyDeque" << std::endl;
+    TestMoveOnly<std::deque>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(moveOnlyQueue)
+{
+    std::cout << "moveOnlyQueue" << std::endl;
+    TestMoveOnly<std::queue>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(moveOnlyStack)
+{
+    std::cout << "moveOnlyStack" << std::endl;
+    TestMoveOnly<std::stack>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(moveOnlySharded)
+{
+    std::cout << "moveOnlySharded" << std::endl;
+    CShardedSyncContainer<std::queue<std::unique_ptr<int>>> queue(2);
+    queue.push(std::unique_ptr<int>(new int(1)));
+    queue.emplace(new int(2));
+    std::unique_ptr<int> item;
+    int sum = 0;
+    while(queue.popNoSleep(item))
+        sum += *item;
+    BOOST_CHECK(sum == 3);
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(popOrSleepLockFreeQueue)
+{
+    std::cout << "popOrSleepLockFreeQueue" << std::endl;
+    TestPopOrSleep<std::queue<int>, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(popOrSleepLockFreeStack)
+{
+    std::cout << "popOrSleepLockFreeStack" << std::endl;
+    TestPopOrSleep<std::stack<int>, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(popNoSleepLockFreeQueue)
+{
+    std::cout << "popNoSleepLockFreeQueue" << std::endl;
+    TestPopNoSleep<std::queue<int>, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(popNoSleepLockFreeStack)
+{
+    std::cout << "popNoSleepLockFreeStack" << std::endl;
+    TestPopNoSleep<std::stack<int>, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(boundedPushLockFreeQueue)
+{
+    std::cout << "boundedPushLockFreeQueue" << std::endl;
+    TestBoundedPush<std::queue<int>, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(boundedPushLockFreeStack)
+{
+    std::cout << "boundedPushLockFreeStack" << std::endl;
+    TestBoundedPush<std::stack<int>, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(timedPopLockFreeQueue)
+{
+    std::cout << "timedPopLockFreeQueue" << std::endl;
+    TestTimedPop<std::queue<int>, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(timedPopLockFreeStack)
+{
+    std::cout << "timedPopLockFreeStack" << std::endl;
+    TestTimedPop<std::stack<int>, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(moveOnlyLockFreeQueue)
+{
+    std::cout << "moveOnlyLockFreeQueue" << std::endl;
+    TestMoveOnly<std::queue, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(moveOnlyLockFreeStack)
+{
+    std::cout << "moveOnlyLockFreeStack" << std::endl;
+    TestMoveOnly<std::stack, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(priorityQueue)
+{
+    std::cout << "priorityQueue" << std::endl;
+    TestPriority<CLockingBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(priorityFineGrained)
+{
+    std::cout << "priorityFineGrained" << std::endl;
+    TestPriority<CFineGrainedBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(popOrSleepPriorityFineGrained)
+{
+    std::cout << "popOrSleepPriorityFineGrained" << std::endl;
+    TestPopOrSleep<std::priority_queue<int>, CFineGrainedBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(boundedPushPriorityFineGrained)
+{
+    std::cout << "boundedPushPriorityFineGrained" << std::endl;
+    TestBoundedPush<std::priority_queue<int>, CFineGrainedBackend>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(boundedPushPriority)
+{
+    std::cout << "boundedPushPriority" << std::endl;
+    TestBoundedPush<std::priority_queue<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(pipeline)
+{
+    std::cout << "pipeline" << std::endl;
+    const int items = 100000;
+    std::atomic<long long> sum(0);
+    std::atomic<int> stored(0);
+    CPipeline<std::string> input(16);
+    auto sink = input.stage("parse", [](const std::string& line){ return std::stoi(line); }, 2, 16, 64)
+                     .stage("square", [](int value){ return (long long)value * value; }, 3, 4, 32)
+                     .stage("store", [&sum, &stored](long long value){ sum += value; ++stored; }, 2);
+    for(int i = 0; i < items; ++i)
+        BOOST_CHECK(input.push(std::to_string(i % 100)));
+    input.close();
+    BOOST_CHECK(!input.push(std::string("1")));
+    sink.wait();
+    long long expected = 0;
+    for(int i = 0; i < items; ++i)
+        expected += (long long)(i % 100) * (i % 100);
+    BOOST_CHECK(stored.load() == items);
+    BOOST_CHECK(sum.load() == expected);
+    auto stats = sink.stats();
+    BOOST_CHECK(stats.size() == 3);
+    for(auto& stage: stats)
+    {
+        std::cout << stage.name << "\tx" << stage.parallelism << "\t" << stage.processed << " items in "
+                  << stage.batches << " batches\t" << stage.throughput() << " items/s\tutilization "
+                  << stage.utilization() << "\tqueue latency " << stage.meanQueueLatency().count() << "ns" << std::endl;
+        BOOST_CHECK(stage.processed == items);
+        BOOST_CHECK(stage.queued == 0);
+        BOOST_CHECK(stage.batches <= stage.processed);
+        BOOST_CHECK(stage.maxQueueLatency >= stage.meanQueueLatency());
+    }
+    BOOST_CHECK(stats[0].parallelism == 2 && stats[1].parallelism == 3 && stats[2].parallelism == 2);
+
+    std::cout << "Results from the last stage, batched input" << std::endl;
+    CPipeline<int> numbers;
+    auto doubled = numbers.stage("double", [](int value){ return 2 * value; }, 2, 0, 8);
+    std::vector<int> batch;
+    for(int i = 0; i < 100; ++i)
+        batch.push_back(i);
+    BOOST_CHECK(numbers.push(std::move(batch)));
+    numbers.close();
+    std::vector<bool> seen(100, false);
+    size_t received = 0;
+    while(doubled.pop(batch))
+    {
+        BOOST_CHECK(batch.size() <= 8);
+        for(int value: batch)
+            seen[value / 2] = true;
+        received += batch.size();
+    }
+    BOOST_CHECK(received == 100);
+    BOOST_CHECK(std::find(seen.begin(), seen.end(), false) == seen.end());
+    doubled.wait();
+
+    std::cout << "Move-only items" << std::endl;
+    CPipeline<std::unique_ptr<int>> pointers;
+    int total = 0;
+    pointers.stage("unwrap", [](std::unique_ptr<int> value){ return *value; })
+            .stage("sum", [&total](int value){ total += value; });
+    for(int i = 1; i <= 10; ++i)
+        pointers.push(std::unique_ptr<int>(new int(i)));
+    pointers.close();
+    pointers.wait();
+    BOOST_CHECK(total == 55);
+
+    std::cout << "Stats while stages are added" << std::endl;
+    {
+        CPipeline<int> growing;
+        std::atomic<bool> added(false);
+        size_t seen = 0;
+        std::thread monitor([&growing, &added, &seen](){
+            while(!added.load())
+                seen = std::max(seen, growing.stats().size());
+        });
+        auto last = growing.stage("0", [](int value){ return value; });
+        for(int i = 1; i < 50; ++i)
+            last = last.stage(std::to_string(i), [](int value){ return value + 1; });
+        added.store(true);
+        monitor.join();
+        BOOST_CHECK(seen <= 50);
+        growing.push(0);
+        growing.close();
+        std::vector<int> result;
+        BOOST_CHECK(last.pop(result) && result.size() == 1 && result[0] == 49);
+        last.wait();
+    }
+
+    std::cout << "Dropping a pipeline with a full tail" << std::endl;
+    {
+        CPipeline<int> undrained;
+        undrained.stage("copy", [](int value){ return value; }, 1, 2)
+                 .stage("copy again", [](int value){ return value; }, 2, 2);
+        for(int i = 0; i < 1000; ++i)
+            undrained.push(i);
+    }
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(selector)
+{
+    std::cout << "selector" << std::endl;
+    CSyncContainer<std::queue<int>> high;
+    CSyncContainer<std::deque<int>> normal;
+    CSyncContainer<std::queue<int>, CLockFreeBackend> background;
+    int item;
+    {
+        CSyncSelector<int> selector;
+        BOOST_CHECK(selector.add(high) == 0);
+        BOOST_CHECK(selector.add(normal) == 1);
+        BOOST_CHECK(selector.add(background) == 2);
+        BOOST_CHECK(selector.popAnyNoSleep(item) == -1);
+        for(int i = 0; i < 3; ++i)
+        {
+            background.push(30 + i);
+            normal.push(20 + i);
+            high.push(10 + i);
+        }
+        std::vector<int> sources;
+        while(selector.popAnyNoSleep(item) >= 0)
+            sources.push_back(item / 10 - 1);
+        BOOST_CHECK((sources == std::vector<int>{0, 0, 0, 1, 1, 1, 2, 2, 2}));
+    }
+    {
+        CSyncSelector<int> selector(CSyncSelector<int>::ROUND_ROBIN);
+        selector.add(high);
+        selector.add(normal);
+        for(int i = 0; i < 2; ++i)
+        {
+            normal.push(1);
+            high.push(0);
+        }
+        std::vector<int> sources;
+        int index;
+        while((index = selector.popAnyNoSleep(item)) >= 0)
+            sources.push_back(index);
+        BOOST_CHECK((sources == std::vector<int>{0, 1, 0, 1}));
+    }
+
+    std::cout << "Wakeup and timeout" << std::endl;
+    {
+        CSyncSelector<int> selector;
+        selector.add(high);
+        selector.add(normal);
+        auto start = std::chrono::steady_clock::now();
+        BOOST_CHECK(selector.popAnyFor(item, std::chrono::milliseconds(20)) == -1);
+        BOOST_CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+        auto producer = new std::thread([&normal](){
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            normal.push(7);
+        });
+        BOOST_CHECK(selector.popAnyFor(item, std::chrono::seconds(10)) == 1);
+        BOOST_CHECK(item == 7);
+        producer->join();
+        delete producer;
+
+        std::cout << "With termination:" << std::endl;
+        int index = 0;
+        auto consumer = new std::thread([&selector, &index](){
+            int value;
+            index = selector.popAny(value);
+        });
+        high.terminate();
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        BOOST_CHECK(!selector.isTerminated());
+        normal.terminate();
+        consumer->join();
+        delete consumer;
+        BOOST_CHECK(index == -1);
+        BOOST_CHECK(selector.isTerminated());
+        high.restart();
+        normal.restart();
+    }
+
+    std::cout << "Producer/consumer pools:" << std::endl;
+    const int itemsPerProducer = 50000;
+    const int nConsumers = 4;
+    std::vector<long long> sums(nConsumers, 0);
+    std::vector<std::thread*> consumers;
+    for(int i = 0; i < nConsumers; ++i)
+        consumers.push_back(new std::thread([&, i](){
+            CSyncSelector<int> selector(i % 2 == 0 ? CSyncSelector<int>::PRIORITY : CSyncSelector<int>::ROUND_ROBIN);
+            selector.add(high);
+            selector.add(normal);
+            selector.add(background);
+            int value;
+            while(selector.popAny(value) >= 0)
+                sums[i] += value;
+        }));
+    std::vector<std::thread*> producers;
+    producers.push_back(new std::thread([&high, itemsPerProducer](){
+        for(int j = 0; j < itemsPerProducer; ++j)
+            high.push(1);
+    }));
+    producers.push_back(new std::thread([&normal, itemsPerProducer](){
+        for(int j = 0; j < itemsPerProducer; ++j)
+            normal.push(1);
+    }));
+    producers.push_back(new std::thread([&background, itemsPerProducer](){
+        for(int j = 0; j < itemsPerProducer; ++j)
+            background.push(1);
+    }));
+    for(auto th: producers)
+    {
+        th->join();
+        delete th;
+    }
+    high.terminate();
+    normal.terminate();
+    background.terminate();
+    for(auto th: consumers)
+    {
+        th->join();
+        delete th;
+    }
+    long long sum = 0;
+    for(auto consumed: sums)
+        sum += consumed;
+    std::cout << "sum: " << sum << std::endl;
+    BOOST_CHECK(sum == 3 * itemsPerProducer);
+    std::cout << std::endl;
+}
+struct SharedMessage
+{
+    int producer;
+    int sequence;
+    char payload[56];
+};
+//Runs body in a forked child, Joined reports whether it returned true
+template <class FUNCTION>
+pid_t Fork(FUNCTION body)
+{
+    pid_t pid = fork();
+    if(pid == 0)
+        _exit(body() ? 0 : 1);
+    return pid;
+}
+bool Joined(pid_t pid)
+{
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+//Waits for the child to exit but leaves it a zombie, Joined reaps it later
+void Exited(pid_t pid)
+{
+    siginfo_t info;
+    waitid(P_PID, pid, &info, WEXITED | WNOWAIT);
+}
+//A waiter killed in its sleep stays counted until releaseDead, every notify would be a syscall
+BOOST_AUTO_TEST_CASE(sharedEventCountDeadWaiter)
+{
+    std::cout << "sharedEventCountDeadWaiter" << std::endl;
+    void* memory = mmap(nullptr, sizeof(CSharedEventCount), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    BOOST_REQUIRE(memory != MAP_FAILED);
+    CSharedEventCount* eventCount = new (memory) CSharedEventCount();
+    eventCount->initialize();
+    pid_t child = Fork([eventCount](){
+        eventCount->wait(eventCount->prepareWait());
+        return true;
+    });
+    while(eventCount->waiters.load() == 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    uint32_t key = eventCount->prepareWait();
+    kill(child, SIGKILL);
+    BOOST_CHECK(!Joined(child));
+    BOOST_CHECK(eventCount->waiters.load() == 2);
+    eventCount->releaseDead();
+    BOOST_CHECK(eventCount->waiters.load() == 1);
+    eventCount->notify();
+    eventCount->wait(key);
+    BOOST_CHECK(eventCount->waiters.load() == 0);
+    munmap(memory, sizeof(CSharedEventCount));
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(sharedMemory)
+{
+    std::cout << "sharedMemory" << std::endl;
+    const std::string name = "/SyncContainerTest." + std::to_string(getpid());
+    const int itemsPerProducer = 100000;
+    const int nProduceres = 2;
+    CSharedSyncContainer<SharedMessage>::unlink(name);
+    CSharedSyncContainer<SharedMessage> queue(name, 50);
+    BOOST_CHECK(queue.capacity() == 64);
+    std::vector<pid_t> producers;
+    for(int i = 0; i < nProduceres; ++i)
+        producers.push_back(Fork([&name, i, itemsPerProducer](){
+            CSharedSyncContainer<SharedMessage> attached(name, 64);
+            for(int j = 0; j < itemsPerProducer; ++j)
+            {
+                SharedMessage message;
+                message.producer = i;
+                message.sequence = j;
+                if(!attached.pushOrSleep(message))
+                    return false;
+            }
+            return true;
+        }));
+    std::vector<int> last(nProduceres, -1);
+    bool ordered = true;
+    for(int i = 0; i < nProduceres * itemsPerProducer; ++i)
+    {
+        SharedMessage message;
+        BOOST_REQUIRE(queue.popOrSleep(message));
+        if(message.sequence != last[message.producer] + 1)
+            ordered = false;
+        last[message.producer] = message.sequence;
+    }
+    for(auto pid: producers)
+        BOOST_CHECK(Joined(pid));
+    BOOST_CHECK(ordered);
+    BOOST_CHECK(queue.size() == 0);
+
+    std::cout << "Zero-copy and termination" << std::endl;
+    pid_t child = Fork([&name](){
+        CSharedSyncContainer<SharedMessage> attached(name, 64);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        SharedMessage* message = attached.beginPushOrSleep();
+        message->producer = 7;
+        attached.commitPush(message);
+        attached.terminate();
+        return true;
+    });
+    const SharedMessage* received = queue.beginPopOrSleep();
+    BOOST_REQUIRE(received != nullptr);
+    BOOST_CHECK(received->producer == 7);
+    queue.endPop(received);
+    BOOST_CHECK(queue.beginPopOrSleep() == nullptr);
+    BOOST_CHECK(Joined(child));
+    BOOST_CHECK(queue.isTerminated());
+    queue.restart();
+
+    std::cout << "Process identity" << std::endl;
+    BOOST_CHECK(CSharedProcess::pid() == getpid());
+    BOOST_CHECK(!CSharedProcess::isDead(CSharedProcess::id()));
+    //Same pid, different start time: the pid was reused
+    BOOST_CHECK(CSharedProcess::isDead(CSharedProcess::id() ^ 1));
+
+    std::cout << "Recovery from a producer that died mid-push, not reaped yet" << std::endl;
+    child = Fork([&name](){
+        CSharedSyncContainer<SharedMessage> attached(name, 64);
+        return attached.tryBeginPush() != nullptr;
+    });
+    Exited(child);
+    SharedMessage message;
+    message.sequence = 1;
+    BOOST_CHECK(queue.tryPush(message));
+    BOOST_CHECK(!queue.popNoSleep(message));
+    BOOST_CHECK(queue.recover() == 1);
+    BOOST_CHECK(Joined(child));
+    message.sequence = 0;
+    BOOST_CHECK(queue.popNoSleep(message));
+    BOOST_CHECK(message.sequence == 1);
+
+    std::cout << "Recovery from a child using a container created before fork" << std::endl;
+    child = Fork([&queue](){
+        return queue.tryBeginPush() != nullptr;
+    });
+    BOOST_CHECK(Joined(child));
+    BOOST_CHECK(queue.recover() == 1);
+    BOOST_CHECK(!queue.popNoSleep(message));
+
+    std::cout << "Recovery from a consumer that died mid-pop" << std::endl;
+    BOOST_CHECK(queue.tryPush(message));
+    child = Fork([&name](){
+        CSharedSyncContainer<SharedMessage> attached(name, 64);
+        return attached.tryBeginPop() != nullptr;
+    });
+    BOOST_CHECK(Joined(child));
+    size_t pushed = 0;
+    while(queue.tryPush(message))
+        ++pushed;
+    BOOST_CHECK(pushed == queue.capacity() - 1);
+    {
+        CSharedSyncContainer<SharedMessage> attached(name, 64);
+        BOOST_CHECK(attached.tryPush(message));
+    }
+    size_t popped = 0;
+    while(queue.popNoSleep(message))
+        ++popped;
+    BOOST_CHECK(popped == queue.capacity());
+
+    BOOST_CHECK_THROW(CSharedSyncContainer<SharedMessage>(name, 128), std::system_error);
+    CSharedSyncContainer<SharedMessage>::unlink(name);
+    std::cout << std::endl;
+}
+#ifdef SYNC_CONTAINER_COROUTINES
+template <class CONTAINER, class BACKEND>
+CSyncTask AwaitConsume(CSyncContainer<CONTAINER, BACKEND>& queue, ISyncExecutor& executor,
+                       std::atomic<long long>& sum, std::atomic<int>& popped, std::atomic<int>& finished)
+{
+    while(auto item = co_await queue.pop(executor))
+    {
+        sum += *item;
+        ++popped;
+    }
+    ++finished;
+}
+//Thousands of coroutine consumers share a few threads, terminate resumes all of them with nullopt
+template <class CONTAINER, class BACKEND = CLockingBackend>
+void TestAwaitPop()
+{
+    const int nConsumers = 2000;
+    const int nProducers = 2;
+    const int itemsPerProducer = 50000;
+    CSyncContainer<CONTAINER, BACKEND> queue;
+    std::atomic<long long> sum(0);
+    std::atomic<int> popped(0);
+    std::atomic<int> finished(0);
+    {
+        CThreadPoolExecutor executor(4, CpuTopology::SCATTER);
+        for(int i = 0; i < nConsumers; ++i)
+            AwaitConsume(queue, executor, sum, popped, finished);
+        std::vector<std::thread*> producers;
+        for(int i = 0; i < nProducers; ++i)
+            producers.push_back(new std::thread([&queue, itemsPerProducer](){
+                for(int j = 1; j <= itemsPerProducer; ++j)
+                    queue.push(j);
+            }));
+        for(auto producer: producers)
+        {
+            producer->join();
+            delete producer;
+        }
+        while(popped.load() < nProducers * itemsPerProducer)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        BOOST_CHECK(finished.load() == 0);
+        queue.terminate();
+        while(finished.load() < nConsumers)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        //Terminated and empty: completes without suspending
+        AwaitConsume(queue, executor, sum, popped, finished);
+        BOOST_CHECK(finished.load() == nConsumers + 1);
+    }
+    BOOST_CHECK(popped.load() == nProducers * itemsPerProducer);
+    BOOST_CHECK(sum.load() == (long long)nProducers * itemsPerProducer * (itemsPerProducer + 1) / 2);
+}
+BOOST_AUTO_TEST_CASE(awaitPopDeque)
+{
+    std::cout << "awaitPopDeque" << std::endl;
+    TestAwaitPop<std::deque<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(awaitPopQueue)
+{
+    std::cout << "awaitPopQueue" << std::endl;
+    TestAwaitPop<std::queue<int>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(awaitPopLockFreeQueue)
+{
+    std::cout << "awaitPopLockFreeQueue" << std::endl;
+    TestAwaitPop<std::queue<int>, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+#endif
+#ifdef SYNC_CONTAINER_METRICS
+template <class CONTAINER, class BACKEND = CLockingBackend>
+void TestMetrics()
+{
+    CSyncContainer<CONTAINER, BACKEND> queue;
+    queue.setMaxSpin(std::chrono::nanoseconds(0));
+    for(int i = 0; i < 100; ++i)
+        queue.push(i);
+    int item;
+    for(int i = 0; i < 40; ++i)
+        BOOST_REQUIRE(queue.popNoSleep(item));
+    CSyncMetricsSnapshot snapshot = queue.metrics();
+    BOOST_CHECK(snapshot.depth == 60);
+    BOOST_CHECK(snapshot.highWater == 100);
+    BOOST_CHECK(snapshot.enqueued == 100);
+    BOOST_CHECK(snapshot.dequeued == 40);
+    BOOST_CHECK(snapshot.sleeps == 0);
+    BOOST_CHECK(snapshot.sojournCount() == 0);
+    while(queue.popNoSleep(item));
+    auto consumer = new std::thread([&queue](){
+        int item;
+        queue.popOrSleep(item);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.push(0);
+    consumer->join();
+    delete consumer;
+    snapshot = queue.metrics();
+    BOOST_CHECK(snapshot.depth == 0);
+    BOOST_CHECK(snapshot.dequeued == 101);
+    BOOST_CHECK(snapshot.sleeps >= 1);
+    BOOST_CHECK(snapshot.sleepTime >= std::chrono::milliseconds(10));
+}
+template <class CONTAINER, class BACKEND = CLockingBackend>
+void TestSojourn()
+{
+    CSyncContainer<CONTAINER, BACKEND> queue;
+    for(int i = 0; i < 10; ++i)
+        queue.push(i);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    CTimestamped<int> item;
+    for(int i = 0; i < 10; ++i)
+        BOOST_REQUIRE(queue.popNoSleep(item));
+    CSyncMetricsSnapshot snapshot = queue.metrics();
+    BOOST_CHECK(snapshot.sojournCount() == 10);
+    BOOST_CHECK(snapshot.sojournQuantile(0.5) >= std::chrono::milliseconds(5));
+    BOOST_CHECK(snapshot.sojournQuantile(1.0) <= std::chrono::seconds(10));
+}
+BOOST_AUTO_TEST_CASE(metricsDeque)
+{
+    std::cout << "metricsDeque" << std::endl;
+    TestMetrics<std::deque<int>>();
+    TestSojourn<std::deque<CTimestamped<int>>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(metricsQueue)
+{
+    std::cout << "metricsQueue" << std::endl;
+    TestMetrics<std::queue<int>>();
+    TestSojourn<std::queue<CTimestamped<int>>>();
+    std::cout << std::endl;
+}
+BOOST_AUTO_TEST_CASE(metricsLockFreeQueue)
+{
+    std::cout << "metricsLockFreeQueue" << std::endl;
+    TestMetrics<std::queue<int>, CLockFreeBackend>();
+    TestSojourn<std::queue<CTimestamped<int>>, CLockFreeBackend>();
+    std::cout << std::endl;
+}
+#endif
+//Fake sysfs tree of 2 packages x 2 cores x 2 SMT threads, numbered the way Linux usually does:
+//cpu = thread * 4 + package * 2 + core, one NUMA node and L3 per package, one L2 per core
+void WriteSysfs(const std::string& path, const std::string& value)
+{
+    std::string directory = path.substr(0, path.rfind('/'));
+    for(size_t slash = directory.find('/', 1); ; slash = directory.find('/', slash + 1))
+    {
+        mkdir(directory.substr(0, slash).c_str(), 0755);
+        if(slash == std::string::npos)
+            break;
+    }
+    std::ofstream(path) << value << std::endl;
+}
+std::string FakeSysfs()
+{
+    char root[] = "/tmp/topologyXXXXXX";
+    BOOST_REQUIRE(mkdtemp(root) != nullptr);
+    std::string cpuRoot = std::string(root) + "/cpu";
+    std::string nodeRoot = std::string(root) + "/node";
+    WriteSysfs(cpuRoot + "/online", "0-7");
+    WriteSysfs(nodeRoot + "/online", "0-1");
+    WriteSysfs(nodeRoot + "/node0/cpulist", "0-1,4-5");
+    WriteSysfs(nodeRoot + "/node1/cpulist", "2-3,6-7");
+    for(int cpu = 0; cpu < 8; ++cpu)
+    {
+        int core = cpu % 2;
+        int package = cpu / 2 % 2;
+        std::string prefix = cpuRoot + "/cpu" + std::to_string(cpu);
+        WriteSysfs(prefix + "/topology/core_id", std::to_string(core));
+        WriteSysfs(prefix + "/topology/physical_package_id", std::to_string(package));
+        int first = package * 2 + core;
+        std::string caches[][3] = {{"1", "Data", std::to_string(first) + "," + std::to_string(first + 4)},
+                                   {"1", "Instruction", std::to_string(first) + "," + std::to_string(first + 4)},
+                                   {"2", "Unified", std::to_string(first) + "," + std::to_string(first + 4)},
+                                   {"3", "Unified", std::to_string(package * 2) + "-" + std::to_string(package * 2 + 1) + ","
+                                                    + std::to_string(package * 2 + 4) + "-" + std::to_string(package * 2 + 5)}};
+        for(int index = 0; index < 4; ++index)
+        {
+            std::string cache = prefix + "/cache/index" + std::to_string(index);
+            WriteSysfs(cache + "/level", caches[index][0]);
+            WriteSysfs(cache + "/type", caches[index][1]);
+            WriteSysfs(cache + "/shared_cpu_list", caches[index][2]);
+        }
+    }
+    return root;
+}
+BOOST_AUTO_TEST_CASE(cpuTopology)
+{
+    std::cout << "cpuTopology" << std::endl;
+    BOOST_CHECK(CpuTopology::parseCpuList("0-2,5,7-8") == std::vector<int>({0, 1, 2, 5, 7, 8}));
+    BOOST_CHECK(CpuTopology::parseCpuList("").empty());
+
+    std::string root = FakeSysfs();
+    CpuTopology topology(root + "/cpu", root + "/node");
+    std::cout << topology.describe() << std::endl;
+    BOOST_CHECK(topology.cpus().size() == 8);
+    BOOST_CHECK(topology.cores() == 4);
+    BOOST_CHECK(topology.packages() == 2);
+    BOOST_CHECK(topology.nodes() == 2);
+    BOOST_CHECK(topology.cpu(6)->node == 1);
+    BOOST_CHECK(topology.smtSiblings(1) == std::vector<int>({1, 5}));
+    BOOST_CHECK(topology.sharingCache(1, 2) == std::vector<int>({1, 5}));
+    BOOST_CHECK(topology.sharingCache(1, 3) == std::vector<int>({0, 1, 4, 5}));
+    BOOST_CHECK(topology.placement(CpuTopology::COMPACT, 8) == std::vector<int>({0, 4, 1, 5, 2, 6, 3, 7}));
+    BOOST_CHECK(topology.placement(CpuTopology::SCATTER, 8) == std::vector<int>({0, 2, 1, 3, 4, 6, 5, 7}));
+    BOOST_CHECK(topology.placement(CpuTopology::ONE_PER_CORE, 6) == std::vector<int>({0, 1, 2, 3, 0, 1}));
+    //A cpuset without CPUs 0, 4, 6 and 7: core 0 of package 0 has nothing left, the others keep one CPU
+    topology.allow({5, 1, 2, 3});
+    BOOST_CHECK(!topology.allowed(0) && topology.allowed(5));
+    BOOST_CHECK(topology.placement(CpuTopology::COMPACT, 5) == std::vector<int>({1, 5, 2, 3, 1}));
+    BOOST_CHECK(topology.placement(CpuTopology::ONE_PER_CORE, 4) == std::vector<int>({1, 2, 3, 1}));
+    topology.allow({});
+    BOOST_CHECK(topology.placement(CpuTopology::COMPACT, 2) == std::vector<int>({0, 4}));
+
+    //Nothing to read: every CPU the runtime reports is a core of its own
+    CpuTopology flat(root + "/missing", root + "/missing");
+    BOOST_CHECK(flat.cpus().size() == std::max(1u, std::thread::hardware_concurrency()));
+    BOOST_CHECK(flat.cores() == flat.cpus().size());
+    BOOST_CHECK(system(("rm -rf " + root).c_str()) == 0);
+
+    //The real machine only places threads on CPUs the process may use, so pinning succeeds
+    int cpu = CpuTopology::instance().placement(CpuTopology::COMPACT, 1)[0];
+    std::vector<int> affinity = CpuTopology::affinity();
+    BOOST_CHECK(affinity.empty() || std::find(affinity.begin(), affinity.end(), cpu) != affinity.end());
+    bool pinnedThere = false;
+    std::thread pinned([cpu, &pinnedThere](){
+        pinnedThere = CpuTopology::pinCurrentThread(cpu) && sched_getcpu() == cpu;
+    });
+    pinned.join();
+    BOOST_CHECK(affinity.empty() || pinnedThere);
+    std::cout << std::endl;
+}
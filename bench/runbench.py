@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+"""Runs every benchmark of the top-level build N times and compares the results with a baseline.
+
+Each benchmark appends its metrics as JSON lines to the file named by BENCHMARK_REPORT
+(see Common/include/BenchmarkReport.hpp). Every metric gets the median of its samples and an
+order-statistic confidence interval of that median. The results, with host metadata, go to --output.
+
+Against a baseline written earlier with --save-baseline, a metric counts as a regression when its
+median moved the wrong way by more than --threshold and the two confidence intervals do not
+overlap. The exit status is 1 when anything regressed.
+
+    cmake -S . -B build && cmake --build build -j
+    bench/runbench.py --build-dir build --save-baseline bench/baselines/$(hostname).json
+    ... change code, rebuild ...
+    bench/runbench.py --build-dir build --baseline bench/baselines/$(hostname).json
+"""
+
+import argparse
+import datetime
+import json
+import math
+import os
+import platform
+import re
+import subprocess
+import sys
+import tempfile
+
+#name, executable relative to the build directory, arguments, arguments with --quick
+BENCHMARKS = [
+    ("futex", "Futex/FutexUnitTest", ["100000000"], ["10000000"]),
+    ("lockfreestack", "LockFreeStack/LockFreeStackBenchmark", [], []),
+    ("lockfreestack-unpadded", "LockFreeStack/LockFreeStackBenchmarkUnpadded", [], []),
+    ("synccontainer-throughput", "SyncContainer/ShardedBenchmark", [], []),
+    ("synccontainer-throughput-unpadded", "SyncContainer/ShardedBenchmarkUnpadded", [], []),
+    ("synccontainer-handoff", "SyncContainer/HandoffLatencyBenchmark", [], []),
+    ("synccontainer-priority", "SyncContainer/PriorityBenchmark", [], []),
+    ("synccontainer-pipeline", "SyncContainer/PipelineBenchmark", [], []),
+    ("synccontainer-ipc", "SyncContainer/SharedMemoryBenchmark", [], []),
+    ("stripedhashmap", "StripedHashMap/StripedHashMapBenchmark", [], []),
+    ("pingpong", "PingPong/pingpong",
+     ["--threads", "2", "--stride", "1,64", "--pinning", "none,socket", "--iterations", "20000000"],
+     ["--threads", "2", "--stride", "1,64", "--store", "relaxed,rmw", "--iterations", "2000000"]),
+]
+
+
+def read_file(path):
+    try:
+        with open(path) as file:
+            return file.read().strip()
+    except OSError:
+        return None
+
+
+def command_output(command, cwd=None):
+    try:
+        return subprocess.run(command, cwd=cwd, capture_output=True, text=True, check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def cmake_cache(build_dir, key):
+    cache = read_file(os.path.join(build_dir, "CMakeCache.txt")) or ""
+    match = re.search(r"^%s:[A-Z]+=(.*)$" % re.escape(key), cache, re.MULTILINE)
+    return match.group(1) if match else None
+
+
+def host_metadata(build_dir):
+    cpuinfo = read_file("/proc/cpuinfo") or ""
+    model = re.search(r"^model name\s*:\s*(.*)$", cpuinfo, re.MULTILINE)
+    compiler = cmake_cache(build_dir, "CMAKE_CXX_COMPILER")
+    source = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    commit = command_output(["git", "rev-parse", "HEAD"], source)
+    dirty = command_output(["git", "status", "--porcelain", "--untracked-files=no"], source)
+    return {
+        "hostname": platform.node(),
+        "kernel": platform.release(),
+        "machine": platform.machine(),
+        "cpu_model": model.group(1) if model else platform.processor(),
+        "logical_cpus": os.cpu_count(),
+        "online_cpus": read_file("/sys/devices/system/cpu/online"),
+        "governor": read_file("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor"),
+        "compiler": (command_output([compiler, "--version"]) or "").split("\n")[0] if compiler else None,
+        "build_type": cmake_cache(build_dir, "CMAKE_BUILD_TYPE"),
+        "commit": commit + ("-dirty" if dirty else "") if commit else None,
+        "date": datetime.datetime.now(datetime.timezone.utc).isoformat(timespec="seconds"),
+    }
+
+
+def median(values):
+    ordered = sorted(values)
+    middle = len(ordered) // 2
+    if len(ordered) % 2:
+        return ordered[middle]
+    return (ordered[middle - 1] + ordered[middle]) / 2
+
+
+def median_coverage(n, k):
+    """Probability that x(k+1), x(n-k) of n samples, 0-based order statistics k and n-1-k,
+    enclose the true median"""
+    return 1 - 2 * sum(math.comb(n, i) for i in range(k + 1)) / 2.0 ** n
+
+
+def median_interval(values, confidence):
+    """Distribution-free interval of the median from order statistics: the narrowest symmetric pair
+    whose binomial coverage still reaches confidence, all of the samples when even the outermost pair
+    falls short (fewer than 6 runs at 95%)"""
+    ordered = sorted(values)
+    n = len(ordered)
+    k = 0
+    while k < (n - 1) // 2 and median_coverage(n, k + 1) >= confidence:
+        k += 1
+    return ordered[k], ordered[n - 1 - k]
+
+
+def summarize(samples, confidence):
+    results = {}
+    for name, (unit, better, values) in sorted(samples.items()):
+        low, high = median_interval(values, confidence)
+        results[name] = {"median": median(values), "ci_low": low, "ci_high": high,
+                         "unit": unit, "better": better, "samples": values}
+    return results
+
+
+def run_benchmarks(build_dir, repeat, quick, only):
+    samples = {}
+    for name, executable, arguments, quick_arguments in BENCHMARKS:
+        if only and not re.search(only, name):
+            continue
+        path = os.path.join(build_dir, executable)
+        if not os.access(path, os.X_OK):
+            print("skipping %s, %s is not built" % (name, path), file=sys.stderr)
+            continue
+        for run in range(repeat):
+            print("%s: run %d/%d" % (name, run + 1, repeat), file=sys.stderr)
+            with tempfile.NamedTemporaryFile(suffix=".jsonl") as report:
+                environment = dict(os.environ, BENCHMARK_REPORT=report.name)
+                subprocess.run([path] + (quick_arguments if quick else arguments), env=environment,
+                               stdout=subprocess.DEVNULL, check=True)
+                with open(report.name) as lines:
+                    for line in lines:
+                        record = json.loads(line)
+                        entry = samples.setdefault(record["name"], (record["unit"], record["better"], []))
+                        entry[2].append(record["value"])
+    return samples
+
+
+def compare(results, baseline, threshold):
+    """Returns (name, verdict, relative change) for metrics present in both, verdict is
+    regression, improvement or same"""
+    verdicts = []
+    for name, current in sorted(results.items()):
+        base = baseline.get(name)
+        if base is None or base["median"] == 0:
+            continue
+        change = (current["median"] - base["median"]) / abs(base["median"])
+        worse = -change if current["better"] == "higher" else change
+        separated = current["ci_high"] < base["ci_low"] or current["ci_low"] > base["ci_high"]
+        if separated and worse > threshold:
+            verdict = "regression"
+        elif separated and -worse > threshold:
+            verdict = "improvement"
+        else:
+            verdict = "same"
+        verdicts.append((name, verdict, change))
+    return verdicts
+
+
+def print_comparison(verdicts, results, baseline):
+    width = max([len(name) for name, _, _ in verdicts] + [6])
+    print("%-*s  %14s  %14s  %-10s  %8s  %s" % (width, "metric", "baseline", "current", "unit", "change", "verdict"))
+    for name, verdict, change in verdicts:
+        print("%-*s  %14.6g  %14.6g  %-10s  %+7.1f%%  %s" % (width, name, baseline[name]["median"], results[name]["median"],
+                                                          results[name]["unit"], 100 * change,
+                                                          verdict.upper() if verdict == "regression" else verdict))
+
+
+def self_test():
+    steady = [100.0, 101.0, 99.0, 100.5, 99.5]
+    assert median(steady) == 100.0
+    low, high = median_interval(steady, 0.95)
+    assert 99.0 <= low <= 100.0 <= high <= 101.0
+    baseline = summarize({"throughput": ("ops/s", "higher", steady), "latency": ("ns", "lower", steady)}, 0.95)
+    slower = summarize({"throughput": ("ops/s", "higher", [v * 0.8 for v in steady]),
+                        "latency": ("ns", "lower", [v * 0.8 for v in steady])}, 0.95)
+    verdicts = dict((name, verdict) for name, verdict, _ in compare(slower, baseline, 0.05))
+    assert verdicts == {"throughput": "regression", "latency": "improvement"}, verdicts
+    for n in range(6, 41):
+        values = [float(v) for v in range(n)]
+        low, high = median_interval(values, 0.95)
+        k = int(low)
+        assert high == n - 1 - k and median_coverage(n, k) >= 0.95, (n, k)
+        assert k == (n - 1) // 2 or median_coverage(n, k + 1) < 0.95, (n, k)
+    assert median_interval([float(v) for v in range(10)], 0.95) == (1.0, 8.0)
+    assert median_interval([float(v) for v in range(20)], 0.95) == (5.0, 14.0)
+    noisy = summarize({"throughput": ("ops/s", "higher", [60.0, 140.0, 95.0, 105.0, 80.0])}, 0.95)
+    assert compare(noisy, baseline, 0.05)[0][1] == "same"
+    print("runbench self test passed")
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--build-dir", default="build", help="top-level CMake build directory")
+    parser.add_argument("--repeat", type=int, default=5, help="runs of every benchmark")
+    parser.add_argument("--quick", action="store_true", help="shorter benchmark arguments")
+    parser.add_argument("--only", help="regular expression selecting benchmarks by name")
+    parser.add_argument("--output", help="results file, default BUILD_DIR/benchmark-results.json")
+    parser.add_argument("--baseline", help="results file to compare against")
+    parser.add_argument("--save-baseline", help="also write the results here")
+    parser.add_argument("--threshold", type=float, default=0.05, help="relative change that counts")
+    parser.add_argument("--confidence", type=float, default=0.95, help="confidence level of the intervals")
+    parser.add_argument("--self-test", action="store_true", help="check the statistics and exit")
+    arguments = parser.parse_args()
+    if arguments.self_test:
+        return self_test()
+
+    build_dir = os.path.abspath(arguments.build_dir)
+    report = {"host": host_metadata(build_dir), "repeat": arguments.repeat, "quick": arguments.quick,
+              "confidence": arguments.confidence}
+    report["results"] = summarize(run_benchmarks(build_dir, arguments.repeat, arguments.quick, arguments.only),
+                                  arguments.confidence)
+    for path in filter(None, [arguments.output or os.path.join(build_dir, "benchmark-results.json"),
+                              arguments.save_baseline]):
+        if os.path.dirname(path):
+            os.makedirs(os.path.dirname(path), exist_ok=True)
+        with open(path, "w") as file:
+            json.dump(report, file, indent=2, sort_keys=True)
+        print("results written to %s" % path, file=sys.stderr)
+    if not arguments.baseline:
+        return 0
+
+    with open(arguments.baseline) as file:
+        baseline = json.load(file)
+    for key in ("cpu_model", "logical_cpus", "compiler", "build_type"):
+        if baseline["host"].get(key) != report["host"].get(key):
+            print("warning: baseline %s is %r, this host has %r" % (key, baseline["host"].get(key),
+                                                                     report["host"].get(key)), file=sys.stderr)
+    if baseline.get("quick") != report["quick"]:
+        print("warning: baseline and current runs differ in --quick", file=sys.stderr)
+    verdicts = compare(report["results"], baseline["results"], arguments.threshold)
+    print_comparison(verdicts, report["results"], baseline["results"])
+    regressions = [name for name, verdict, _ in verdicts if verdict == "regression"]
+    print("%d metrics compared, %d regressions" % (len(verdicts), len(regressions)))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())